@@ -2,21 +2,46 @@
 #ifndef CHIP8_H_
 #define CHIP8_H_
 
-#include <SDL2/SDL.h>
 #include <chip8registers.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #define CHIP8_MEMORY_SIZE 4096
 #define CHIP8_START_ADDRESS 0x200
 #define CHIP8_FONTSET_SIZE 80
+#define CHIP8_ROM_MAX_SIZE (CHIP8_MEMORY_SIZE - CHIP8_START_ADDRESS)
 
 #define CHIP8_STACK_SIZE 16
 #define CHIP8_KEYPAD_SIZE 16
 
 #define CHIP8_DISPLAY_WIDTH 64
 #define CHIP8_DISPLAY_HEIGHT 32
-#define CHIP8_DISPLAY_SIZE CHIP8_DISPLAY_WIDTH *CHIP8_DISPLAY_HEIGHT
+#define CHIP8_DISPLAY_SIZE (CHIP8_DISPLAY_WIDTH * CHIP8_DISPLAY_HEIGHT)
+
+/* RND seed set by chip8_init(), fixed so runs are reproducible */
+#define CHIP8_DEFAULT_SEED 0x2545F491
+
+/* Entries of struct Chip8 decoded, other values name a fused idiom */
+#define CHIP8_DECODED_UNKNOWN 0
+#define CHIP8_DECODED_PLAIN 1
+
+/* Longest line chip8_disassemble_opcode() produces, including the NUL */
+#define CHIP8_DISASSEMBLY_SIZE 48
+
+/* Returned by every fallible library call, CHIP8_OK is 0 */
+enum Chip8Error {
+    CHIP8_OK = 0,
+    CHIP8_ERROR_ARGUMENT,
+    CHIP8_ERROR_OPEN,
+    CHIP8_ERROR_READ,
+    CHIP8_ERROR_WRITE,
+    CHIP8_ERROR_TOO_LARGE,
+    CHIP8_ERROR_MEMORY,
+    CHIP8_ERROR_FORMAT,
+    CHIP8_ERROR_EXISTS
+};
 
 struct Chip8 {
     struct Chip8Registers regs;
@@ -25,13 +50,28 @@ struct Chip8 {
     uint8_t keypad[CHIP8_KEYPAD_SIZE];
     uint8_t display[CHIP8_DISPLAY_SIZE];
     bool draw_flag;
+    uint16_t keys_observed; /* Pressed keys the ROM read, bit per key */
+    uint32_t rng; /* Per-instance RND state so forks replay identically */
+    uint8_t decoded[CHIP8_MEMORY_SIZE]; /* Fused idiom by address, 0 unknown */
 };
 
 void chip8_init(struct Chip8 *chip8);
-void chip8_load(struct Chip8 *chip8, const char *filename);
-extern void chip8_disassemble(const char *filename, FILE *output_stream);
+int chip8_load(struct Chip8 *chip8, const char *filename);
+int chip8_load_memory(struct Chip8 *chip8, const uint8_t *rom, size_t size);
+int chip8_disassemble(const char *filename, FILE *output_stream);
+int chip8_disassemble_memory(const uint8_t *rom, size_t size,
+                             FILE *output_stream);
+int chip8_disassemble_opcode(size_t address, uint16_t opcode, char *buffer,
+                             size_t buffer_size);
 void chip8_cycle(struct Chip8 *chip8);
-void chip8_draw(struct Chip8 *chip8, SDL_Renderer *renderer,
-                SDL_Texture *texture, uint8_t window_scale);
+void chip8_execute(struct Chip8 *chip8, uint16_t opcode);
+void chip8_timers(struct Chip8 *chip8);
+unsigned chip8_step(struct Chip8 *chip8, unsigned budget);
+void chip8_run(struct Chip8 *chip8, unsigned long cycles);
+void chip8_invalidate(struct Chip8 *chip8, uint16_t address, size_t size);
+void chip8_seed(struct Chip8 *chip8, uint32_t seed);
+void chip8_fork(const struct Chip8 *parent, struct Chip8 *child);
+uint64_t chip8_hash(const void *data, size_t size);
+const char *chip8_strerror(int error);
 
 #endif /* CHIP8_H_ */
@@ -0,0 +1,88 @@
+#ifndef CHIP8GOLDEN_H_
+#define CHIP8GOLDEN_H_
+
+#include <chip8.h>
+#include <chip8native.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Golden-state regression checks. A ROM is run by the reference
+ * interpreter (chip8_cycle) with a scripted input and the state hash after
+ * every frame is saved to a golden file. Any other engine can then be run
+ * against the file, and the first cycle where it leaves the reference is
+ * found by replaying the frame that went wrong. Nothing is kept between
+ * calls, so separate golden files can be checked from several threads.
+ *
+ * Golden files are text: a "FCHIP8-GOLDEN 1 <cycles per frame> <frames>"
+ * header and one 16 digit hex hash per line. Input scripts have one
+ * "<frame> <key> <0|1>" line per key change, applied before that frame
+ * runs, with # starting a comment. chip8_golden_list() drives a whole
+ * corpus from a list of "rom golden [inputs|-] [rom.so]" lines.
+ */
+
+#define CHIP8_GOLDEN_VERSION 1
+
+struct Chip8GoldenInput {
+    unsigned long frame;
+    uint8_t key;
+    uint8_t pressed;
+};
+
+struct Chip8Golden {
+    unsigned cycles_per_frame;
+    unsigned long frames;
+    uint64_t *hashes; /* chip8_state_hash() after each frame */
+    struct Chip8GoldenInput *inputs; /* Sorted by frame */
+    size_t input_count;
+};
+
+/* An execution engine, run must behave like that many chip8_cycle() calls */
+struct Chip8GoldenEngine {
+    const char *name;
+    void (*run)(struct Chip8 *chip8, unsigned long cycles, void *user_data);
+    /* Optional, called before run is given a state it did not produce */
+    void (*reset)(void *user_data);
+    void *user_data;
+};
+
+struct Chip8GoldenResult {
+    bool diverged;
+    unsigned long frame; /* First frame whose hash differs */
+    unsigned long cycle; /* Cycles run when the engine left the reference */
+    uint16_t address;    /* Reference PC before that cycle */
+    uint16_t opcode;     /* Instruction at address before it ran */
+    bool reference_agrees; /* Engine matches chip8_cycle, the golden is stale */
+    struct Chip8 expected; /* Reference state at that cycle */
+    struct Chip8 actual;
+};
+
+extern const struct Chip8GoldenEngine chip8_golden_reference;
+extern const struct Chip8GoldenEngine chip8_golden_fused;
+
+void chip8_golden_init(struct Chip8Golden *golden, unsigned cycles_per_frame);
+void chip8_golden_free(struct Chip8Golden *golden);
+int chip8_golden_load_inputs(struct Chip8Golden *golden, const char *path);
+int chip8_golden_load(struct Chip8Golden *golden, const char *path);
+int chip8_golden_save(const struct Chip8Golden *golden, const char *path);
+int chip8_golden_record(struct Chip8Golden *golden, const struct Chip8 *initial,
+                        unsigned long frames);
+int chip8_golden_verify(const struct Chip8Golden *golden,
+                        const struct Chip8 *initial,
+                        const struct Chip8GoldenEngine *engine,
+                        struct Chip8GoldenResult *result);
+void chip8_golden_native(struct Chip8GoldenEngine *engine,
+                         struct Chip8Native *native);
+void chip8_golden_diff(const struct Chip8 *expected, const struct Chip8 *actual,
+                       FILE *output_stream);
+bool chip8_golden_report(const char *rom, const struct Chip8Golden *golden,
+                         const struct Chip8GoldenEngine *engine,
+                         const struct Chip8GoldenResult *result,
+                         double seconds, FILE *output_stream);
+int chip8_golden_list(const char *path, bool record, unsigned long frames,
+                      unsigned cycles_per_frame, FILE *output_stream,
+                      unsigned long *failures);
+
+#endif /* CHIP8GOLDEN_H_ */
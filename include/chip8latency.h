@@ -0,0 +1,53 @@
+#ifndef CHIP8LATENCY_H_
+#define CHIP8LATENCY_H_
+
+#include <chip8.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Input-to-photon latency. A key press is followed through three points:
+ * the frontend handling the key event, the ROM first reading the key with
+ * Ex9E/ExA1/Fx0A (see keys_observed in struct Chip8) and the first changed
+ * frame presented after that. Times are in microseconds from any clock
+ * the caller likes.
+ */
+
+/* Bucket i holds values in [2^i, 2^(i+1)), bucket 0 also holds 0 */
+#define CHIP8_LATENCY_BUCKETS 32
+
+struct Chip8Histogram {
+    uint64_t buckets[CHIP8_LATENCY_BUCKETS];
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+};
+
+struct Chip8Latency {
+    uint64_t cycle; /* Cycles run so far */
+    uint16_t pending;  /* Pressed keys the ROM has not read yet */
+    uint16_t observed; /* Read keys waiting for a changed frame */
+    uint64_t pressed_at[CHIP8_KEYPAD_SIZE];
+    uint64_t pressed_cycle[CHIP8_KEYPAD_SIZE];
+    uint64_t observed_at[CHIP8_KEYPAD_SIZE];
+
+    struct Chip8Histogram poll;        /* Event to ROM read, microseconds */
+    struct Chip8Histogram poll_cycles; /* Event to ROM read, cycles */
+    struct Chip8Histogram present;     /* ROM read to present, microseconds */
+    struct Chip8Histogram total;       /* Event to present, microseconds */
+};
+
+void chip8_latency_init(struct Chip8Latency *latency);
+void chip8_latency_key(struct Chip8Latency *latency, uint8_t key,
+                       uint64_t now);
+void chip8_latency_observe(struct Chip8Latency *latency, struct Chip8 *chip8,
+                           unsigned cycles, uint64_t now);
+void chip8_latency_present(struct Chip8Latency *latency, uint64_t now);
+uint64_t chip8_histogram_percentile(const struct Chip8Histogram *histogram,
+                                    double percentile);
+int chip8_latency_summary(const struct Chip8Latency *latency, char *buffer,
+                          size_t buffer_size);
+void chip8_latency_print(const struct Chip8Latency *latency, FILE *output);
+
+#endif /* CHIP8LATENCY_H_ */
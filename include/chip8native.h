@@ -0,0 +1,76 @@
+#ifndef CHIP8NATIVE_H_
+#define CHIP8NATIVE_H_
+
+#include <chip8.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Ahead-of-time compiled ROMs. chip8_compile() turns a ROM into a C
+ * translation unit with one function per basic block. Built as a shared
+ * object with the host compiler, it is loaded by chip8_native_open() and
+ * run by chip8_native_run() in place of chip8_cycle().
+ */
+
+#define CHIP8_NATIVE_ABI_VERSION 3
+#define CHIP8_NATIVE_SYMBOL "chip8_native_module"
+
+/*
+ * Longest block in instructions. A block only runs when the remaining
+ * budget covers all of it, so give chip8_native_run() at least this many
+ * cycles at a time.
+ */
+#define CHIP8_NATIVE_MAX_BLOCK 16
+
+typedef void (*Chip8NativeFunction)(struct Chip8 *chip8);
+
+struct Chip8NativeBlock {
+    uint16_t start;
+    uint16_t length; /* Bytes of code covered */
+    uint16_t cycles; /* Instructions retired by every call */
+    bool writes_memory;
+    Chip8NativeFunction function;
+};
+
+/* Exported by every compiled ROM under CHIP8_NATIVE_SYMBOL */
+struct Chip8NativeModule {
+    uint32_t abi_version;
+    uint32_t chip8_size;
+    const uint8_t *rom;
+    uint16_t rom_size;
+    const struct Chip8NativeBlock *blocks;
+    uint16_t block_count;
+
+    /* Filled in by the loader, used for the larger instructions */
+    void (*execute)(struct Chip8 *chip8, uint16_t opcode);
+};
+
+/* A loaded module, use one per running instance */
+struct Chip8Native {
+    void *handle;
+    struct Chip8NativeModule *module;
+    bool validated;
+
+    /* Block whose code covers each address, matching memory or not */
+    const struct Chip8NativeBlock *owners[CHIP8_MEMORY_SIZE];
+    bool overlapping; /* Some address is covered by two blocks */
+    /* Dispatch table by address, NULL falls back to the interpreter */
+    const struct Chip8NativeBlock *table[CHIP8_MEMORY_SIZE];
+};
+
+/* Same as that many chip8_timers() calls, blocks tick in batches */
+static inline void chip8_native_ticks(struct Chip8 *chip8, unsigned ticks) {
+    chip8->regs.DT = chip8->regs.DT > ticks ? chip8->regs.DT - ticks : 0;
+    chip8->regs.ST = chip8->regs.ST > ticks ? chip8->regs.ST - ticks : 0;
+}
+
+int chip8_compile(const uint8_t *rom, size_t size, FILE *output_stream);
+int chip8_native_open(struct Chip8Native *native, const char *path);
+void chip8_native_close(struct Chip8Native *native);
+void chip8_native_validate(struct Chip8Native *native,
+                           const struct Chip8 *chip8);
+void chip8_native_run(struct Chip8Native *native, struct Chip8 *chip8,
+                      unsigned long cycles);
+
+#endif /* CHIP8NATIVE_H_ */
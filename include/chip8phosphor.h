@@ -0,0 +1,31 @@
+#ifndef CHIP8PHOSPHOR_H_
+#define CHIP8PHOSPHOR_H_
+
+#include <chip8.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Phosphor persistence. Lit pixels go to full intensity and unlit ones
+ * fade by decay / 256 every frame, which hides the flicker of sprites
+ * being XOR-erased and redrawn. Works on the 64x32 display before it is
+ * scaled, so the cost does not depend on the window size.
+ */
+
+#define CHIP8_PHOSPHOR_DEFAULT_DECAY 160
+
+struct Chip8Phosphor {
+    alignas(32) uint8_t intensity[CHIP8_DISPLAY_SIZE];
+    alignas(32) uint32_t pixels[CHIP8_DISPLAY_SIZE]; /* ARGB8888 output */
+    uint32_t palette[256];                           /* Per intensity */
+    uint8_t decay;
+    bool active; /* Some pixel is still fading */
+};
+
+void chip8_phosphor_init(struct Chip8Phosphor *phosphor, uint8_t decay,
+                         uint32_t background, uint32_t foreground);
+void chip8_phosphor_update(struct Chip8Phosphor *phosphor,
+                           const uint8_t *display);
+
+#endif /* CHIP8PHOSPHOR_H_ */
@@ -4,6 +4,8 @@
 
 #include <SDL2/SDL.h>
 #include <chip8.h>
+#include <chip8latency.h>
+#include <chip8phosphor.h>
 #include <stdbool.h>
 
 struct SDLChip8 {
@@ -12,10 +14,16 @@ struct SDLChip8 {
     SDL_Texture *texture;
     SDL_Event event;
     int window_scale;
+    struct Chip8Phosphor *phosphor; /* Optional post-process, NULL if off */
+    Uint32 last_present;
+    struct Chip8Latency *latency; /* Optional measurement, NULL if off */
+    uint64_t presented_hash; /* chip8_hash() of the last presented display */
 };
 
 int sdl_chip8_init(struct SDLChip8 *sdl_chip8, int window_scale);
 void sdl_chip8_destroy(struct SDLChip8 *sdl_chip8);
 bool sdl_chip8_events(struct SDLChip8 *sdl_chip8, struct Chip8 *chip8);
+uint64_t sdl_chip8_microseconds(void);
+bool sdl_chip8_draw(struct SDLChip8 *sdl_chip8, struct Chip8 *chip8);
 
 #endif /* CHIP8SDL_H_ */
@@ -0,0 +1,29 @@
+#ifndef CHIP8SEARCH_H_
+#define CHIP8SEARCH_H_
+
+#include <chip8.h>
+#include <stdint.h>
+
+/* Inputs tried from every state: each single key held, or no key */
+#define CHIP8_SEARCH_NO_KEY 0xFF
+#define CHIP8_SEARCH_INPUTS (CHIP8_KEYPAD_SIZE + 1)
+
+/* Higher is better. Called concurrently from worker threads */
+typedef long (*Chip8ScoreFunction)(const struct Chip8 *chip8, void *user_data);
+
+struct Chip8SearchOptions {
+    int beam_width;      /* States kept per step */
+    int depth;           /* Number of input steps */
+    int cycles_per_step; /* Cycles run with each input held */
+    int threads;         /* Worker threads, 0 or 1 runs inline */
+    Chip8ScoreFunction score;
+    void *user_data;
+    long *duplicates; /* Optional, incremented by the states dropped */
+};
+
+uint64_t chip8_state_hash(const struct Chip8 *chip8);
+int chip8_search(const struct Chip8 *root,
+                 const struct Chip8SearchOptions *options, uint8_t *inputs,
+                 int *length, long *score);
+
+#endif /* CHIP8SEARCH_H_ */
@@ -0,0 +1,52 @@
+#ifndef CHIP8SHM_H_
+#define CHIP8SHM_H_
+
+#include <chip8.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CHIP8_SHM_MAGIC 0x38504843 /* "CHP8" */
+#define CHIP8_SHM_VERSION 2
+
+/*
+ * Layout of the shared-memory segment. The emulator runs directly on
+ * chip8, so nothing is copied to publish a frame. sequence is a seqlock:
+ * it is odd while the emulator is mutating chip8 and readers retry if it
+ * was odd or changed while they were copying.
+ */
+struct Chip8Shm {
+    uint32_t magic;
+    uint32_t version;
+    _Atomic uint32_t sequence;
+    _Atomic uint16_t keys; /* Keys held by external processes, bit per key */
+    uint64_t frames;       /* Frames presented, protected by sequence */
+    struct Chip8 chip8;
+};
+
+/* Per-process handle to a segment */
+struct Chip8SharedMemory {
+    struct Chip8Shm *shm;
+    char name[256];
+    bool owner;
+    uint16_t keys; /* Injected keys already applied to the keypad */
+};
+
+int chip8_shm_create(struct Chip8SharedMemory *handle, const char *name);
+int chip8_shm_attach(struct Chip8SharedMemory *handle, const char *name);
+void chip8_shm_destroy(struct Chip8SharedMemory *handle);
+
+/*
+ * Emulator side, brackets every mutation of shm->chip8, including the
+ * frontend clearing draw_flag. frame counts a newly presented frame.
+ */
+void chip8_shm_begin(struct Chip8SharedMemory *handle);
+void chip8_shm_end(struct Chip8SharedMemory *handle, bool frame);
+
+/* External side */
+void chip8_shm_read(const struct Chip8SharedMemory *handle,
+                    struct Chip8 *snapshot, uint64_t *frames);
+void chip8_shm_press(struct Chip8SharedMemory *handle, uint8_t key,
+                     bool pressed);
+
+#endif /* CHIP8SHM_H_ */
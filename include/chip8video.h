@@ -0,0 +1,52 @@
+#ifndef CHIP8VIDEO_H_
+#define CHIP8VIDEO_H_
+
+#include <chip8.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Emulated frame rate and how many cycles make up one frame */
+#define CHIP8_VIDEO_FPS 60
+#define CHIP8_VIDEO_CYCLES_PER_FRAME 16
+
+/* Largest pixel scale, keeps frame sizes far from int overflow */
+#define CHIP8_VIDEO_MAX_SCALE 64
+
+enum Chip8VideoFormat {
+    CHIP8_VIDEO_Y4M, /* YUV4MPEG2 stream, monochrome */
+    CHIP8_VIDEO_RGB, /* Raw 24-bit RGB stream */
+    CHIP8_VIDEO_PNG  /* Numbered PNG sequence */
+};
+
+struct Chip8Video {
+    enum Chip8VideoFormat format;
+    FILE *output;
+    const char *pattern;
+    /* PNG file names: pattern up to the %, then the padded frame number */
+    int pattern_prefix;
+    int pattern_width;
+    bool pattern_zero;
+    const char *pattern_suffix;
+    int scale;
+    int width;
+    int height;
+    unsigned long frames;
+    unsigned long repeats;
+
+    /* Previous frame, kept to detect and re-emit repeats */
+    uint64_t last_hash;
+    uint8_t last_display[CHIP8_DISPLAY_SIZE];
+
+    /* Scaled frame in the output format and the last encoded PNG */
+    uint8_t *pixels;
+    size_t pixels_size;
+    uint8_t *encoded;
+    size_t encoded_size;
+};
+
+int chip8_video_open(struct Chip8Video *video, const char *path, int scale);
+int chip8_video_frame(struct Chip8Video *video, const struct Chip8 *chip8);
+void chip8_video_close(struct Chip8Video *video);
+
+#endif /* CHIP8VIDEO_H_ */
@@ -2,7 +2,6 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include <chip8.h>
@@ -15,6 +14,11 @@
 #define CHIP8_INSTRUCTION_NN(opcode) (opcode & 0x00FF)
 #define CHIP8_INSTRUCTION_NNN(opcode) (opcode & 0x0FFF)
 
+/* Wraps indices so a misbehaving ROM can never reach outside the arrays */
+#define CHIP8_ADDRESS(address) ((address) & (CHIP8_MEMORY_SIZE - 1))
+#define CHIP8_STACK_INDEX(sp) ((sp) & (CHIP8_STACK_SIZE - 1))
+#define CHIP8_KEY(key) ((key) & (CHIP8_KEYPAD_SIZE - 1))
+
 /* Fontset */
 static const uint8_t chip8_fontset[CHIP8_FONTSET_SIZE] = {
         0xF0, 0x90, 0x90, 0x90, 0xF0, /* 0 */
@@ -39,10 +43,11 @@ static const uint8_t chip8_fontset[CHIP8_FONTSET_SIZE] = {
 void chip8_init(struct Chip8 *chip8) {
     /* Clear all the arrays */
     memset(chip8->memory, 0, CHIP8_MEMORY_SIZE);
-    memset(chip8->stack, 0, CHIP8_STACK_SIZE);
+    memset(chip8->stack, 0, sizeof(chip8->stack));
     memset(chip8->keypad, 0, CHIP8_KEYPAD_SIZE);
     memset(chip8->display, 0, CHIP8_DISPLAY_SIZE);
     memset(chip8->regs.V, 0, 16);
+    memset(chip8->decoded, 0, sizeof(chip8->decoded));
 
     /* Load the fontset */
     memcpy(chip8->memory, chip8_fontset, CHIP8_FONTSET_SIZE);
@@ -53,14 +58,17 @@ void chip8_init(struct Chip8 *chip8) {
     chip8->regs.SP = 0;
     chip8->regs.DT = 0;
     chip8->regs.ST = 0;
+
+    chip8->draw_flag = false;
+    chip8->keys_observed = 0;
+    chip8->rng = CHIP8_DEFAULT_SEED;
 }
 
-/* Load a ROM into the memory */
-void chip8_load(struct Chip8 *chip8, const char *filename) {
+/* Load a ROM file into the memory */
+int chip8_load(struct Chip8 *chip8, const char *filename) {
     FILE *file_descriptor = fopen(filename, "rb");
     if (file_descriptor == NULL) {
-        fprintf(stderr, "Could not open file %s\n", filename);
-        exit(1);
+        return CHIP8_ERROR_OPEN;
     }
 
     /* Get the file size */
@@ -68,23 +76,94 @@ void chip8_load(struct Chip8 *chip8, const char *filename) {
     long file_size = ftell(file_descriptor);
     rewind(file_descriptor);
 
+    if (file_size < 0) {
+        fclose(file_descriptor);
+        return CHIP8_ERROR_READ;
+    }
+    if (file_size > CHIP8_ROM_MAX_SIZE) {
+        fclose(file_descriptor);
+        return CHIP8_ERROR_TOO_LARGE;
+    }
+
     /* Read the file into memory */
-    fread(chip8->memory + CHIP8_START_ADDRESS, 1, file_size, file_descriptor);
+    size_t read = fread(chip8->memory + CHIP8_START_ADDRESS, 1, file_size,
+                        file_descriptor);
     fclose(file_descriptor);
+    chip8_invalidate(chip8, CHIP8_START_ADDRESS, read);
+
+    return read == (size_t) file_size ? CHIP8_OK : CHIP8_ERROR_READ;
+}
 
-    printf("Loaded %s into memory\n", filename);
+/* Load a ROM already in memory, e.g. embedded or received over a socket */
+int chip8_load_memory(struct Chip8 *chip8, const uint8_t *rom, size_t size) {
+    if (rom == NULL && size > 0) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    if (size > CHIP8_ROM_MAX_SIZE) {
+        return CHIP8_ERROR_TOO_LARGE;
+    }
+    memcpy(chip8->memory + CHIP8_START_ADDRESS, rom, size);
+    chip8_invalidate(chip8, CHIP8_START_ADDRESS, size);
+    return CHIP8_OK;
 }
+
+/* Reseeds RND, xorshift never leaves 0 so that maps to the default */
+void chip8_seed(struct Chip8 *chip8, uint32_t seed) {
+    chip8->rng = seed != 0 ? seed : CHIP8_DEFAULT_SEED;
+}
+
+/* xorshift32, replaces rand() so every instance owns its random stream */
+static inline uint32_t next_random(struct Chip8 *chip8) {
+    uint32_t value = chip8->rng;
+    value ^= value << 13;
+    value ^= value >> 17;
+    value ^= value << 5;
+    chip8->rng = value;
+    return value;
+}
+
+/* Reads a key for Ex9E, ExA1 and Fx0A, noting pressed keys the ROM saw */
+static inline uint8_t read_key(struct Chip8 *chip8, uint8_t key) {
+    uint8_t pressed = chip8->keypad[CHIP8_KEY(key)];
+    if (pressed) {
+        chip8->keys_observed |= 1 << CHIP8_KEY(key);
+    }
+    return pressed;
+}
+
 /* Fetches an opcode */
 static inline uint16_t fetch_opcode(struct Chip8 *chip8) {
     uint16_t opcode =
-            chip8->memory[chip8->regs.PC] << 8 | chip8->memory[chip8->regs.PC + 1];
+            chip8->memory[CHIP8_ADDRESS(chip8->regs.PC)] << 8 |
+            chip8->memory[CHIP8_ADDRESS(chip8->regs.PC + 1)];
     chip8->regs.PC += 2;
     return opcode;
 }
 
 /* A single cycle */
 void chip8_cycle(struct Chip8 *chip8) {
-    uint16_t opcode = fetch_opcode(chip8);
+    chip8_execute(chip8, fetch_opcode(chip8));
+    chip8_timers(chip8);
+}
+
+/*
+ * Runs exactly the given number of instructions, fusing where possible.
+ * Instructions already known not to start an idiom are dispatched here so
+ * the interpreter is inlined, everything else goes through chip8_step().
+ */
+void chip8_run(struct Chip8 *chip8, unsigned long cycles) {
+    while (cycles > 0) {
+        if (chip8->decoded[CHIP8_ADDRESS(chip8->regs.PC)] == CHIP8_DECODED_PLAIN) {
+            chip8_cycle(chip8);
+            cycles--;
+        } else {
+            cycles -= chip8_step(chip8, cycles > 0xFFFF ? 0xFFFF : cycles);
+        }
+    }
+}
+
+/* Executes an already fetched opcode, PC must point past it */
+void chip8_execute(struct Chip8 *chip8, uint16_t opcode) {
     uint8_t x = CHIP8_INSTRUCTION_X(opcode);
     uint8_t y = CHIP8_INSTRUCTION_Y(opcode);
     uint8_t n = CHIP8_INSTRUCTION_N(opcode);
@@ -96,9 +175,11 @@ void chip8_cycle(struct Chip8 *chip8) {
             switch (nn) {
                 case 0xE0: /* CLS */
                     memset(chip8->display, 0, sizeof(chip8->display));
+                    chip8->draw_flag = true;
                     break;
                 case 0xEE: /* RET */
-                    chip8->regs.PC = chip8->stack[--chip8->regs.SP];
+                    chip8->regs.SP = CHIP8_STACK_INDEX(chip8->regs.SP - 1);
+                    chip8->regs.PC = chip8->stack[chip8->regs.SP];
                     break;
                 default:
                     break; /* Unknown instruction, nop */
@@ -109,7 +190,8 @@ void chip8_cycle(struct Chip8 *chip8) {
             chip8->regs.PC = nnn;
             break;
         case 0x2: /* CALL addr */
-            chip8->stack[chip8->regs.SP++] = chip8->regs.PC;
+            chip8->stack[CHIP8_STACK_INDEX(chip8->regs.SP)] = chip8->regs.PC;
+            chip8->regs.SP = CHIP8_STACK_INDEX(chip8->regs.SP + 1);
             chip8->regs.PC = nnn;
             break;
         case 0x3: /* SE Vx, byte */
@@ -184,34 +266,43 @@ void chip8_cycle(struct Chip8 *chip8) {
             chip8->regs.PC = chip8->regs.V[0] + nnn;
             break;
         case 0xC: /* RND Vx, byte */
-            chip8->regs.V[x] = (unsigned char) (rand() % 0xFF) & nn;
+            chip8->regs.V[x] = (unsigned char) (next_random(chip8) % 0xFF) & nn;
             break;
-        case 0xD: /* DRW Vx, Vy, n */
+        case 0xD: { /* DRW Vx, Vy, n */
+            /* Only flag a redraw if a pixel was actually toggled */
+            bool toggled = false;
             chip8->regs.V[0xF] = 0;
             for (int yline = 0; yline < n; yline++) {
-                uint8_t pixel = chip8->memory[chip8->regs.I + yline];
+                uint8_t pixel = chip8->memory[CHIP8_ADDRESS(chip8->regs.I + yline)];
                 for (int xline = 0; xline < 8; xline++) {
                     if ((pixel & (0x80 >> xline)) != 0) {
+                        /* Sprites wrap around each edge of the screen */
                         int index =
-                                (chip8->regs.V[x] + xline + ((chip8->regs.V[y] + yline) * 64));
+                                (chip8->regs.V[x] + xline) % CHIP8_DISPLAY_WIDTH +
+                                (chip8->regs.V[y] + yline) % CHIP8_DISPLAY_HEIGHT *
+                                        CHIP8_DISPLAY_WIDTH;
                         if (chip8->display[index] == 1) {
                             chip8->regs.V[0xF] = 1;
                         }
                         chip8->display[index] ^= 1;
+                        toggled = true;
                     }
                 }
             }
-            chip8->draw_flag = true;
+            if (toggled) {
+                chip8->draw_flag = true;
+            }
             break;
+        }
         case 0xE: {
             switch (nn) {
                 case 0x9E: /* SKP Vx */
-                    if (chip8->keypad[chip8->regs.V[x]]) {
+                    if (read_key(chip8, chip8->regs.V[x])) {
                         chip8->regs.PC += 2;
                     }
                     break;
                 case 0xA1: /* SKNP Vx */
-                    if (!chip8->keypad[chip8->regs.V[x]]) {
+                    if (!read_key(chip8, chip8->regs.V[x])) {
                         chip8->regs.PC += 2;
                     }
                     break;
@@ -226,7 +317,7 @@ void chip8_cycle(struct Chip8 *chip8) {
                     chip8->regs.V[x] = chip8->regs.DT;
                     break;
                 case 0x0A: /* LD Vx, K */
-                    chip8->regs.V[x] = chip8->keypad[chip8->regs.V[x]];
+                    chip8->regs.V[x] = read_key(chip8, chip8->regs.V[x]);
                     break;
                 case 0x15: /* LD DT, Vx */
                     chip8->regs.DT = chip8->regs.V[x];
@@ -241,18 +332,20 @@ void chip8_cycle(struct Chip8 *chip8) {
                     chip8->regs.I = chip8->regs.V[x] * 5;
                     break;
                 case 0x33: /* LD B, Vx */
-                    chip8->memory[chip8->regs.I] = chip8->regs.V[x] / 100;
-                    chip8->memory[chip8->regs.I + 1] = (chip8->regs.V[x] / 10) % 10;
-                    chip8->memory[chip8->regs.I + 2] = (chip8->regs.V[x] % 100) % 10;
+                    chip8->memory[CHIP8_ADDRESS(chip8->regs.I)] = chip8->regs.V[x] / 100;
+                    chip8->memory[CHIP8_ADDRESS(chip8->regs.I + 1)] = (chip8->regs.V[x] / 10) % 10;
+                    chip8->memory[CHIP8_ADDRESS(chip8->regs.I + 2)] = (chip8->regs.V[x] % 100) % 10;
+                    chip8_invalidate(chip8, chip8->regs.I, 3);
                     break;
                 case 0x55: /* LD [I], Vx */
                     for (int i = 0; i <= x; i++) {
-                        chip8->memory[chip8->regs.I + i] = chip8->regs.V[i];
+                        chip8->memory[CHIP8_ADDRESS(chip8->regs.I + i)] = chip8->regs.V[i];
                     }
+                    chip8_invalidate(chip8, chip8->regs.I, x + 1);
                     break;
                 case 0x65: /* LD Vx, [I] */
                     for (int i = 0; i <= x; i++) {
-                        chip8->regs.V[i] = chip8->memory[chip8->regs.I + i];
+                        chip8->regs.V[i] = chip8->memory[CHIP8_ADDRESS(chip8->regs.I + i)];
                     }
                     break;
                 default:
@@ -263,42 +356,62 @@ void chip8_cycle(struct Chip8 *chip8) {
         default:
             break; /* Unknown instruction, nop */
     } /* end of opcode switch */
+}
 
-    /* timers */
-
+/* Ticks the timers, done once after every instruction */
+void chip8_timers(struct Chip8 *chip8) {
     if (chip8->regs.DT > 0) {
         chip8->regs.DT--;
     }
 
-    /* I think SDL has sound maybe ill learn */
+    /* The frontend beeps while ST is non-zero */
     if (chip8->regs.ST > 0) {
-        if (chip8->regs.ST == 1) {
-            printf("^_^ :3\n");
-        }
         chip8->regs.ST--;
     }
 }
 
-void chip8_draw(struct Chip8 *chip8, SDL_Renderer *renderer,
-                SDL_Texture *texture, uint8_t window_scale) {
-    if (!chip8->draw_flag) {
-        return;
-    }
+/*
+ * Clones an instance. The whole machine is a few kilobytes with no
+ * pointers, so a flat copy is already cheaper than any page sharing.
+ */
+void chip8_fork(const struct Chip8 *parent, struct Chip8 *child) {
+    memcpy(child, parent, sizeof(*child));
+}
 
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
+/* 64-bit FNV-1a hash, used to cheaply compare framebuffers and states */
+uint64_t chip8_hash(const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    uint64_t hash = 0xCBF29CE484222325ULL;
 
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
 
-    for (int y = 0; y < 32; y++) {
-        for (int x = 0; x < 64; x++) {
-            if (chip8->display[(y * 64) + x] == 1) {
-                SDL_Rect rect = {x * window_scale, y * window_scale, window_scale,
-                                 window_scale};
-                SDL_RenderFillRect(renderer, &rect);
-            }
-        }
+/* Human readable description of an enum Chip8Error */
+const char *chip8_strerror(int error) {
+    switch (error) {
+        case CHIP8_OK:
+            return "Success";
+        case CHIP8_ERROR_ARGUMENT:
+            return "Invalid argument";
+        case CHIP8_ERROR_OPEN:
+            return "Could not open file";
+        case CHIP8_ERROR_READ:
+            return "Could not read file";
+        case CHIP8_ERROR_WRITE:
+            return "Could not write file";
+        case CHIP8_ERROR_TOO_LARGE:
+            return "ROM is too large";
+        case CHIP8_ERROR_MEMORY:
+            return "Out of memory";
+        case CHIP8_ERROR_FORMAT:
+            return "Unrecognized format";
+        case CHIP8_ERROR_EXISTS:
+            return "Already exists";
+        default:
+            return "Unknown error";
     }
-    SDL_RenderPresent(renderer);
-    chip8->draw_flag = false;
 }
@@ -0,0 +1,397 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chip8native.h>
+
+/* Macros for getting register index, immediate values etc. */
+#define NNN(opcode) (opcode & 0x0FFF)
+#define NN(opcode) (opcode & 0x00FF)
+#define N(opcode) (opcode & 0x000F)
+#define X(opcode) ((opcode & 0x0F00) >> 8)
+#define Y(opcode) ((opcode & 0x00F0) >> 4)
+
+/* What an instruction does to control flow */
+enum Flow {
+    FLOW_NEXT,   /* Falls through */
+    FLOW_JUMP,   /* Static target only */
+    FLOW_CALL,   /* Static target, returns to the next instruction */
+    FLOW_SKIP,   /* Next or the one after */
+    FLOW_WRITE,  /* Falls through, but may have rewritten code */
+    FLOW_DYNAMIC /* RET and JP V0, resolved by the dispatch table */
+};
+
+/* Code discovered by following control flow from the entry point */
+struct Program {
+    const uint8_t *rom;
+    size_t size;
+    bool reachable[CHIP8_MEMORY_SIZE];
+    bool leader[CHIP8_MEMORY_SIZE];
+};
+
+static bool in_rom(const struct Program *program, size_t address) {
+    return address >= CHIP8_START_ADDRESS &&
+           address + 1 < CHIP8_START_ADDRESS + program->size;
+}
+
+static uint16_t opcode_at(const struct Program *program, size_t address) {
+    const uint8_t *code = program->rom + address - CHIP8_START_ADDRESS;
+    return code[0] << 8 | code[1];
+}
+
+static enum Flow classify(uint16_t opcode) {
+    switch (opcode & 0xF000) {
+        case 0x0000:
+            /* Like chip8_execute(), only the low byte picks CLS or RET */
+            return NN(opcode) == 0xEE ? FLOW_DYNAMIC : FLOW_NEXT;
+        case 0x1000:
+            return FLOW_JUMP;
+        case 0x2000:
+            return FLOW_CALL;
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+            return FLOW_SKIP;
+        case 0xB000:
+            return FLOW_DYNAMIC;
+        case 0xE000:
+            return (NN(opcode) == 0x9E || NN(opcode) == 0xA1) ? FLOW_SKIP
+                                                               : FLOW_NEXT;
+        case 0xF000:
+            return (NN(opcode) == 0x33 || NN(opcode) == 0x55) ? FLOW_WRITE
+                                                               : FLOW_NEXT;
+        default:
+            return FLOW_NEXT;
+    }
+}
+
+/* Marks reachable instructions and block leaders with a worklist */
+static void discover(struct Program *program) {
+    uint16_t worklist[CHIP8_MEMORY_SIZE * 2];
+    size_t pending = 0;
+
+    worklist[pending++] = CHIP8_START_ADDRESS;
+    program->leader[CHIP8_START_ADDRESS] = true;
+
+    while (pending > 0) {
+        uint16_t address = worklist[--pending];
+        if (!in_rom(program, address) || program->reachable[address]) {
+            continue;
+        }
+        program->reachable[address] = true;
+
+        uint16_t opcode = opcode_at(program, address);
+        uint16_t targets[2];
+        size_t target_count = 0;
+        bool falls_through = false;
+
+        switch (classify(opcode)) {
+            case FLOW_NEXT:
+                falls_through = true;
+                break;
+            case FLOW_JUMP:
+                targets[target_count++] = NNN(opcode);
+                break;
+            case FLOW_CALL:
+                targets[target_count++] = NNN(opcode);
+                targets[target_count++] = address + 2;
+                break;
+            case FLOW_SKIP:
+                targets[target_count++] = address + 2;
+                targets[target_count++] = address + 4;
+                break;
+            case FLOW_WRITE:
+                targets[target_count++] = address + 2;
+                break;
+            case FLOW_DYNAMIC:
+                break;
+        }
+
+        if (falls_through) {
+            worklist[pending++] = address + 2;
+        }
+        for (size_t i = 0; i < target_count; i++) {
+            if (targets[i] < CHIP8_MEMORY_SIZE) {
+                program->leader[targets[i]] = true;
+                worklist[pending++] = targets[i];
+            }
+        }
+    }
+}
+
+static void emit_flush(FILE *output, unsigned *ticks) {
+    if (*ticks > 0) {
+        fprintf(output, "    chip8_native_ticks(c, %u);\n", *ticks);
+        *ticks = 0;
+    }
+}
+
+static void emit_skip(FILE *output, uint16_t address, const char *condition) {
+    fprintf(output, "    c->regs.PC = (%s) ? 0x%03X : 0x%03X;\n", condition,
+            address + 4, address + 2);
+}
+
+/*
+ * Emits one instruction with the same semantics as chip8_execute(). Timer
+ * ticks are counted in *ticks and only flushed where an instruction reads
+ * or writes a timer. Returns true if the instruction ends the block.
+ */
+static bool emit_instruction(FILE *output, uint16_t address, uint16_t opcode,
+                             unsigned *ticks) {
+    char condition[64];
+    int x = X(opcode), y = Y(opcode);
+    bool ends_block = classify(opcode) != FLOW_NEXT;
+
+    switch (opcode & 0xF000) {
+        case 0x0000:
+            if (NN(opcode) == 0xE0) {
+                fprintf(output, "    chip8_native_module.execute(c, 0x00E0);\n");
+            } else if (NN(opcode) == 0xEE) {
+                fprintf(output, "    c->regs.SP = (c->regs.SP - 1) & %d;\n"
+                                "    c->regs.PC = c->stack[c->regs.SP];\n",
+                        CHIP8_STACK_SIZE - 1);
+            }
+            break;
+        case 0x1000:
+            fprintf(output, "    c->regs.PC = 0x%03X;\n", NNN(opcode));
+            break;
+        case 0x2000:
+            fprintf(output, "    c->stack[c->regs.SP & %d] = 0x%03X;\n"
+                            "    c->regs.SP = (c->regs.SP + 1) & %d;\n"
+                            "    c->regs.PC = 0x%03X;\n",
+                    CHIP8_STACK_SIZE - 1, address + 2, CHIP8_STACK_SIZE - 1,
+                    NNN(opcode));
+            break;
+        case 0x3000:
+        case 0x4000:
+            snprintf(condition, sizeof(condition), "c->regs.V[%d] %s 0x%02X", x,
+                     (opcode & 0xF000) == 0x3000 ? "==" : "!=", NN(opcode));
+            emit_skip(output, address, condition);
+            break;
+        case 0x5000:
+        case 0x9000:
+            snprintf(condition, sizeof(condition), "c->regs.V[%d] %s c->regs.V[%d]",
+                     x, (opcode & 0xF000) == 0x5000 ? "==" : "!=", y);
+            emit_skip(output, address, condition);
+            break;
+        case 0x6000:
+            fprintf(output, "    c->regs.V[%d] = 0x%02X;\n", x, NN(opcode));
+            break;
+        case 0x7000:
+            fprintf(output, "    c->regs.V[%d] += 0x%02X;\n", x, NN(opcode));
+            break;
+        case 0x8000:
+            switch (N(opcode)) {
+                case 0x0:
+                    fprintf(output, "    c->regs.V[%d] = c->regs.V[%d];\n", x, y);
+                    break;
+                case 0x1:
+                    fprintf(output, "    c->regs.V[%d] |= c->regs.V[%d];\n", x, y);
+                    break;
+                case 0x2:
+                    fprintf(output, "    c->regs.V[%d] &= c->regs.V[%d];\n", x, y);
+                    break;
+                case 0x3:
+                    fprintf(output, "    c->regs.V[%d] ^= c->regs.V[%d];\n", x, y);
+                    break;
+                case 0x4:
+                    fprintf(output, "    c->regs.V[15] = (c->regs.V[%d] + c->regs.V[%d] > 0xFF);\n"
+                                    "    c->regs.V[%d] += c->regs.V[%d];\n", x, y, x, y);
+                    break;
+                case 0x5:
+                    fprintf(output, "    c->regs.V[15] = (c->regs.V[%d] > c->regs.V[%d]);\n"
+                                    "    c->regs.V[%d] -= c->regs.V[%d];\n", x, y, x, y);
+                    break;
+                case 0x6:
+                    fprintf(output, "    c->regs.V[15] = c->regs.V[%d] & 0x1;\n"
+                                    "    c->regs.V[%d] >>= 1;\n", x, x);
+                    break;
+                case 0x7:
+                    fprintf(output, "    c->regs.V[15] = (c->regs.V[%d] > c->regs.V[%d]);\n"
+                                    "    c->regs.V[%d] = c->regs.V[%d] - c->regs.V[%d];\n",
+                            y, x, x, y, x);
+                    break;
+                case 0xE:
+                    fprintf(output, "    c->regs.V[15] = c->regs.V[%d] >> 7;\n"
+                                    "    c->regs.V[%d] <<= 1;\n", x, x);
+                    break;
+                default:
+                    break; /* Unknown instruction, nop */
+            }
+            break;
+        case 0xA000:
+            fprintf(output, "    c->regs.I = 0x%03X;\n", NNN(opcode));
+            break;
+        case 0xB000:
+            fprintf(output, "    c->regs.PC = c->regs.V[0] + 0x%03X;\n", NNN(opcode));
+            break;
+        case 0xC000:
+        case 0xD000:
+            fprintf(output, "    chip8_native_module.execute(c, 0x%04X);\n", opcode);
+            break;
+        case 0xE000:
+            if (NN(opcode) == 0x9E || NN(opcode) == 0xA1) {
+                /* Same bookkeeping as read_key() in the interpreter */
+                fprintf(output, "    {\n"
+                                "    uint8_t key = c->regs.V[%d] & %d;\n"
+                                "    if (c->keypad[key]) {\n"
+                                "        c->keys_observed |= 1 << key;\n"
+                                "    }\n",
+                        x, CHIP8_KEYPAD_SIZE - 1);
+                emit_skip(output, address,
+                          NN(opcode) == 0x9E ? "c->keypad[key]" : "!c->keypad[key]");
+                fprintf(output, "    }\n");
+            }
+            break;
+        case 0xF000:
+            switch (NN(opcode)) {
+                case 0x07:
+                    emit_flush(output, ticks);
+                    fprintf(output, "    c->regs.V[%d] = c->regs.DT;\n", x);
+                    break;
+                case 0x15:
+                    emit_flush(output, ticks);
+                    fprintf(output, "    c->regs.DT = c->regs.V[%d];\n", x);
+                    break;
+                case 0x18:
+                    emit_flush(output, ticks);
+                    fprintf(output, "    c->regs.ST = c->regs.V[%d];\n", x);
+                    break;
+                case 0x1E:
+                    fprintf(output, "    c->regs.I += c->regs.V[%d];\n", x);
+                    break;
+                case 0x29:
+                    fprintf(output, "    c->regs.I = c->regs.V[%d] * 5;\n", x);
+                    break;
+                case 0x0A:
+                case 0x33:
+                case 0x55:
+                case 0x65:
+                    fprintf(output, "    chip8_native_module.execute(c, 0x%04X);\n",
+                            opcode);
+                    break;
+                default:
+                    break; /* Unknown instruction, nop */
+            }
+            break;
+    }
+
+    /* The instruction's own tick, after it executed */
+    (*ticks)++;
+    return ends_block;
+}
+
+/* Emits the block starting at address, returns its instruction count */
+static unsigned emit_block(FILE *output, const struct Program *program,
+                           uint16_t start, uint16_t *end, bool *writes) {
+    uint16_t address = start;
+    unsigned cycles = 0, ticks = 0;
+    bool ends_block;
+
+    fprintf(output, "static void block_%03X(struct Chip8 *c) {\n", start);
+    do {
+        uint16_t opcode = opcode_at(program, address);
+        char line[CHIP8_DISASSEMBLY_SIZE];
+
+        chip8_disassemble_opcode(address, opcode, line, sizeof(line));
+        fprintf(output, "    /* %s */\n", line);
+        ends_block = emit_instruction(output, address, opcode, &ticks);
+        *writes = classify(opcode) == FLOW_WRITE;
+        address += 2;
+        cycles++;
+    } while (!ends_block && cycles < CHIP8_NATIVE_MAX_BLOCK &&
+             in_rom(program, address) && !program->leader[address]);
+
+    /* Control flow instructions already set PC */
+    if (!ends_block || classify(opcode_at(program, address - 2)) == FLOW_WRITE) {
+        fprintf(output, "    c->regs.PC = 0x%03X;\n", address);
+    }
+    emit_flush(output, &ticks);
+    fprintf(output, "}\n\n");
+
+    *end = address;
+    return cycles;
+}
+
+/*
+ * Compiles a ROM to C. Only code reachable through static control flow
+ * from the entry point gets a block, anything else, including targets of
+ * JP V0 and code that was rewritten at runtime, runs in the interpreter.
+ */
+int chip8_compile(const uint8_t *rom, size_t size, FILE *output_stream) {
+    if (rom == NULL || size > CHIP8_ROM_MAX_SIZE) {
+        return rom == NULL ? CHIP8_ERROR_ARGUMENT : CHIP8_ERROR_TOO_LARGE;
+    }
+
+    /* Too large for the stack, compiling is not a hot path anyway */
+    struct Program *program = calloc(1, sizeof(*program));
+    struct Chip8NativeBlock *blocks = calloc(CHIP8_MEMORY_SIZE, sizeof(*blocks));
+    if (program == NULL || blocks == NULL) {
+        free(program);
+        free(blocks);
+        return CHIP8_ERROR_MEMORY;
+    }
+
+    program->rom = rom;
+    program->size = size;
+    discover(program);
+
+    fprintf(output_stream, "/* Generated by FChip8, do not edit */\n\n"
+                           "#include <chip8native.h>\n\n"
+                           "extern struct Chip8NativeModule chip8_native_module;\n\n");
+
+    fprintf(output_stream, "static const uint8_t rom[%zu] = {", size ? size : 1);
+    for (size_t i = 0; i < size; i++) {
+        fprintf(output_stream, "%s0x%02X,", i % 12 ? " " : "\n        ", rom[i]);
+    }
+    fprintf(output_stream, "\n};\n\n");
+
+    /* Blocks, remembering their extents for the table */
+    size_t block_count = 0;
+
+    for (uint16_t address = CHIP8_START_ADDRESS; address < CHIP8_MEMORY_SIZE; address++) {
+        if (!program->leader[address] || !program->reachable[address]) {
+            continue;
+        }
+        uint16_t end;
+        struct Chip8NativeBlock *block = &blocks[block_count++];
+        block->start = address;
+        block->cycles = emit_block(output_stream, program, address, &end,
+                                   &block->writes_memory);
+        block->length = end - address;
+
+        /* A block cut at CHIP8_NATIVE_MAX_BLOCK continues in the next one */
+        if (end < CHIP8_MEMORY_SIZE && program->reachable[end]) {
+            program->leader[end] = true;
+        }
+    }
+
+    fprintf(output_stream, "static const struct Chip8NativeBlock blocks[] = {\n");
+    for (size_t i = 0; i < block_count; i++) {
+        fprintf(output_stream, "        {0x%03X, %u, %u, %s, block_%03X},\n",
+                blocks[i].start, blocks[i].length, blocks[i].cycles,
+                blocks[i].writes_memory ? "true" : "false", blocks[i].start);
+    }
+    if (block_count == 0) {
+        fprintf(output_stream, "        {0, 0, 0, false, NULL},\n");
+    }
+    fprintf(output_stream, "};\n\n");
+
+    fprintf(output_stream,
+            "struct Chip8NativeModule chip8_native_module = {\n"
+            "        CHIP8_NATIVE_ABI_VERSION,\n"
+            "        sizeof(struct Chip8),\n"
+            "        rom,\n"
+            "        %zu,\n"
+            "        blocks,\n"
+            "        %zu,\n"
+            "        NULL};\n",
+            size, block_count);
+
+    free(program);
+    free(blocks);
+    return ferror(output_stream) ? CHIP8_ERROR_WRITE : CHIP8_OK;
+}
@@ -1,9 +1,10 @@
 
 #include <stdio.h>
-#include <stdlib.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include <chip8.h>
+
 /* Macros for getting register index, immediate values etc. */
 #define NNN(opcode) (opcode & 0x0FFF)
 #define NN(opcode) (opcode & 0x00FF)
@@ -12,112 +13,196 @@
 #define Y(opcode) ((opcode & 0x00F0) >> 4)
 
 /* 0x0??? sub-opcodes */
-static void chip8_disassemble_0xxx(size_t address, uint16_t opcode, FILE *output) {
+static void chip8_disassemble_0xxx(size_t address, uint16_t opcode, char *buffer, size_t size) {
     switch (opcode & 0x000F) {
         case 0x0000:
-            fprintf(output, "ADDR %#04zx: CLS\n", address);
+            snprintf(buffer, size, "ADDR %#04zx: CLS", address);
             break;
         case 0x000E:
-            fprintf(output, "ADDR %#04zx: RET\n", address);
+            snprintf(buffer, size, "ADDR %#04zx: RET", address);
             break;
         default:
-            fprintf(output, "ADDR %#04zx: SYS 0x%03X\n", address, NNN(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: SYS 0x%03X", address, NNN(opcode));
             break;
     }
 }
 
 /* 0x8??? sub-opcodes */
-static void chip8_disassemble_8xxx(size_t address, uint16_t opcode, FILE *output) {
+static void chip8_disassemble_8xxx(size_t address, uint16_t opcode, char *buffer, size_t size) {
     switch (opcode & 0x000F) {
         case 0x0000:
-            fprintf(output, "ADDR %#04zx: LD V[%d], V[%d]\n", address, X(opcode), Y(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: LD V[%d], V[%d]", address, X(opcode), Y(opcode));
             break;
         case 0x0001:
-            fprintf(output, "ADDR %#04zx: OR V[%d], V[%d]\n", address, X(opcode), Y(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: OR V[%d], V[%d]", address, X(opcode), Y(opcode));
             break;
         case 0x0002:
-            fprintf(output, "ADDR %#04zx: AND V[%d], V[%d]\n", address, X(opcode), Y(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: AND V[%d], V[%d]", address, X(opcode), Y(opcode));
             break;
         case 0x0003:
-            fprintf(output, "ADDR %#04zx: XOR V[%d], V[%d]\n", address, X(opcode), Y(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: XOR V[%d], V[%d]", address, X(opcode), Y(opcode));
             break;
         case 0x0004:
-            fprintf(output, "ADDR %#04zx: ADD V[%d], V[%d]\n", address, X(opcode), Y(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: ADD V[%d], V[%d]", address, X(opcode), Y(opcode));
             break;
         case 0x0005:
-            fprintf(output, "ADDR %#04zx: SUB V[%d], V[%d]\n", address, X(opcode), Y(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: SUB V[%d], V[%d]", address, X(opcode), Y(opcode));
             break;
         case 0x0006:
-            fprintf(output, "ADDR %#04zx: SHR V[%d], V[%d]\n", address, X(opcode), Y(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: SHR V[%d], V[%d]", address, X(opcode), Y(opcode));
             break;
         case 0x0007:
-            fprintf(output, "ADDR %#04zx: SUBN V[%d], V[%d]\n", address, X(opcode), Y(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: SUBN V[%d], V[%d]", address, X(opcode), Y(opcode));
             break;
         case 0x000E:
-            fprintf(output, "ADDR %#04zx: SHL V[%d], V[%d]\n", address, X(opcode), Y(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: SHL V[%d], V[%d]", address, X(opcode), Y(opcode));
             break;
         default:
-            fprintf(output, "ADDR %#04zx: UNKNOWN 0x%04X\n", address, opcode);
+            snprintf(buffer, size, "ADDR %#04zx: UNKNOWN 0x%04X", address, opcode);
             break;
     }
 }
 
 /* 0xe??? sub-opcodes */
-static void chip8_disassemble_exxx(size_t address, uint16_t opcode, FILE *output) {
+static void chip8_disassemble_exxx(size_t address, uint16_t opcode, char *buffer, size_t size) {
     switch (opcode & 0x00FF) {
         case 0x009E:
-            fprintf(output, "ADDR %#04zx: SKP V[%d]\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: SKP V[%d]", address, X(opcode));
             break;
         case 0x00A1:
-            fprintf(output, "ADDR %#04zx: SKNP V[%d]\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: SKNP V[%d]", address, X(opcode));
             break;
         default:
-            fprintf(output, "ADDR %#04zx: Unknown opcode 0x%04X\n", address, opcode);
+            snprintf(buffer, size, "ADDR %#04zx: Unknown opcode 0x%04X", address, opcode);
             break;
     }
 }
 
 /* 0xf??? sub-opcodes */
-static void chip8_disassemble_fxxx(size_t address, uint16_t opcode, FILE *output) {
+static void chip8_disassemble_fxxx(size_t address, uint16_t opcode, char *buffer, size_t size) {
     switch (opcode & 0x00FF) {
         case 0x0007:
-            fprintf(output, "ADDR %#04zx: LD V[%d], DT\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: LD V[%d], DT", address, X(opcode));
             break;
         case 0x000A:
-            fprintf(output, "ADDR %#04zx: LD V[%d], K\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: LD V[%d], K", address, X(opcode));
             break;
         case 0x0015:
-            fprintf(output, "ADDR %#04zx: LD DT, V[%d]\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: LD DT, V[%d]", address, X(opcode));
             break;
         case 0x0018:
-            fprintf(output, "ADDR %#04zx: LD ST, V[%d]\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: LD ST, V[%d]", address, X(opcode));
             break;
         case 0x001E:
-            fprintf(output, "ADDR %#04zx: ADD I, V[%d]\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: ADD I, V[%d]", address, X(opcode));
             break;
         case 0x0029:
-            fprintf(output, "ADDR %#04zx: LD F, V[%d]\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: LD F, V[%d]", address, X(opcode));
             break;
         case 0x0033:
-            fprintf(output, "ADDR %#04zx: LD B, V[%d]\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: LD B, V[%d]", address, X(opcode));
             break;
         case 0x0055:
-            fprintf(output, "ADDR %#04zx: LD [I], V[%d]\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: LD [I], V[%d]", address, X(opcode));
             break;
         case 0x0065:
-            fprintf(output, "ADDR %#04zx: LD V[%X], [I]\n", address, X(opcode));
+            snprintf(buffer, size, "ADDR %#04zx: LD V[%X], [I]", address, X(opcode));
             break;
         default:
-            fprintf(output, "ADDR %#04zx: Unknown opcode 0x%04X\n", address, opcode);
+            snprintf(buffer, size, "ADDR %#04zx: Unknown opcode 0x%04X", address, opcode);
             break;
     }
 }
 
-void chip8_disassemble(const char* filename, FILE* output_stream) {
+/* Disassembles one opcode into a caller-provided buffer, without newline */
+int chip8_disassemble_opcode(size_t address, uint16_t opcode, char *buffer,
+                             size_t buffer_size) {
+    if (buffer == NULL || buffer_size == 0) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    switch ((opcode & 0xF000) >> 12) {  /* 0x?000 */
+        case 0x0:  /* 0x0??? CLS, RET */
+            chip8_disassemble_0xxx(address, opcode, buffer, buffer_size);
+            break;
+        case 0x1: /* 0x1NNN, jump to address NNN */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: JP %#03x", address, NNN(opcode));
+            break;
+        case 0x2: /* 0x2NNN, call subroutine at NNN */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: CALL %#03x", address, NNN(opcode));
+            break;
+        case 0x03:  /* 0x3XNN, skip next instruction if VX == NN */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: SE V[%X], %#02x", address, X(opcode), NN(opcode));
+            break;
+        case 0x4: /* 0x4XNN, skip next instruction if VX != NN */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: SNE V[%X], %#02x", address, X(opcode), NN(opcode));
+            break;
+        case 0x5: /* 0x5XY0, skip next instruction if VX == VY */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: SE V[%X], V[%X]", address, X(opcode), Y(opcode));
+            break;
+        case 0x6: /* 0x6XNN, set VX to NN */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: LD V[%X], %#02x", address, X(opcode), NN(opcode));
+            break;
+        case 0x7: /* 0x7XNN, add NN to VX */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: ADD V[%X], %#02x", address, X(opcode), NN(opcode));
+            break;
+        case 0x8: /* 0x8XY?, arithmetic operations */
+            chip8_disassemble_8xxx(address, opcode, buffer, buffer_size);
+            break;
+        case 0x9: /* 0x9XY0, skip next instruction if VX != VY */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: SNE V[%X], V[%X]", address, X(opcode), Y(opcode));
+            break;
+        case 0xA: /* 0xANNN, set I to NNN */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: LD I, %#03x", address, NNN(opcode));
+            break;
+        case 0xB: /* 0xBNNN, jump to address NNN + V0 */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: JP V[0], %#03x", address, NNN(opcode));
+            break;
+        case 0xC: /* 0xCXNN, set VX to random number & NN */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: RND V[%X], %#02x", address, X(opcode), NN(opcode));
+            break;
+        case 0xD: /* 0xDXYN, draw sprite at (VX, VY) with N bytes of sprite data starting at I */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: DRW V[%X], V[%X], %#01x", address, X(opcode), Y(opcode), N(opcode));
+            break;
+        case 0xE: /* 0xEX??, Key ops */
+            chip8_disassemble_exxx(address, opcode, buffer, buffer_size);
+            break;
+        case 0xF: /* 0xFX??, other misc ops */
+            chip8_disassemble_fxxx(address, opcode, buffer, buffer_size);
+            break;
+        default: /* Unknown opcodes (note only original Chip8 opcodes are supported, some roms use more */
+            snprintf(buffer, buffer_size, "ADDR %#04zx: UNKNOWN OPCODE", address);
+            break;
+    }
+    return CHIP8_OK;
+}
+
+/* Disassembles a ROM image, addresses are offsets into the image */
+int chip8_disassemble_memory(const uint8_t *rom, size_t size,
+                             FILE *output_stream) {
+    char line[CHIP8_DISASSEMBLY_SIZE];
+
+    if (rom == NULL && size > 0) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    /* A trailing odd byte is shown as the high half of an opcode */
+    for (size_t i = 0; i < size; i += 2) {
+        uint16_t opcode = rom[i] << 8 | (i + 1 < size ? rom[i + 1] : 0);
+        chip8_disassemble_opcode(i, opcode, line, sizeof(line));
+        if (fprintf(output_stream, "%s\n", line) < 0) {
+            return CHIP8_ERROR_WRITE;
+        }
+    }
+    return CHIP8_OK;
+}
+
+int chip8_disassemble(const char* filename, FILE* output_stream) {
+    uint8_t memory[CHIP8_ROM_MAX_SIZE];
+
     FILE* file = fopen(filename, "rb");
     if (file == NULL) {
-        fprintf(stderr, "Error: Could not open file %s\n", filename);
-        exit(EXIT_FAILURE);
+        return CHIP8_ERROR_OPEN;
     }
 
     /* Get file size */
@@ -126,82 +211,19 @@ void chip8_disassemble(const char* filename, FILE* output_stream) {
     rewind(file);
 
     /* Check if file is too large */
-    if (file_size > 0x1000 - 0x200) {
-        fprintf(stderr, "Error: File %s is too large\n", filename);
-        exit(EXIT_FAILURE);
+    if (file_size < 0 || file_size > CHIP8_ROM_MAX_SIZE) {
+        fclose(file);
+        return file_size < 0 ? CHIP8_ERROR_READ : CHIP8_ERROR_TOO_LARGE;
     }
 
-    /* Allocate memory and load the rom into memory */
-    uint8_t* memory = malloc(sizeof(uint8_t) * file_size);
-
-    if (memory == NULL) {
-        fprintf(stderr, "Error: Could not allocate memory for file %s\n", filename);
-        exit(EXIT_FAILURE);
-    }
-
-    fread(memory, sizeof(uint8_t), file_size, file);
+    /* Load the rom into a stack buffer, the largest ROM is only 3.5 KB */
+    size_t read = fread(memory, sizeof(uint8_t), file_size, file);
 
     /* Close file */
     fclose(file);
 
-    uint16_t opcode;
-
-    for (size_t i = 0; i < file_size; i += 2) {
-        opcode = memory[i] << 8 | memory[i + 1];
-
-        switch ((opcode & 0xF000) >> 12) {  /* 0x?000 */
-            case 0x0:  /* 0x0??? CLS, RET */
-                chip8_disassemble_0xxx(i, opcode, output_stream);
-                break;
-            case 0x1: /* 0x1NNN, jump to address NNN */
-                fprintf(output_stream, "ADDR %#04zx: JP %#03x\n", i, NNN(opcode));
-                break;
-            case 0x2: /* 0x2NNN, call subroutine at NNN */
-                fprintf(output_stream, "ADDR %#04zx: CALL %#03x\n", i, NNN(opcode));
-                break;
-            case 0x03:  /* 0x3XNN, skip next instruction if VX == NN */
-                fprintf(output_stream, "ADDR %#04zx: SE V[%X], %#02x\n", i, X(opcode), NN(opcode));
-                break;
-            case 0x4: /* 0x4XNN, skip next instruction if VX != NN */
-                fprintf(output_stream, "ADDR %#04zx: SNE V[%X], %#02x\n", i, X(opcode), NN(opcode));
-                break;
-            case 0x5: /* 0x5XY0, skip next instruction if VX == VY */
-                fprintf(output_stream, "ADDR %#04zx: SE V[%X], V[%X]\n", i, X(opcode), Y(opcode));
-                break;
-            case 0x6: /* 0x6XNN, set VX to NN */
-                fprintf(output_stream, "ADDR %#04zx: LD V[%X], %#02x\n", i, X(opcode), NN(opcode));
-                break;
-            case 0x7: /* 0x7XNN, add NN to VX */
-                fprintf(output_stream, "ADDR %#04zx: ADD V[%X], %#02x\n", i, X(opcode), NN(opcode));
-                break;
-            case 0x8: /* 0x8XY?, arithmetic operations */
-                chip8_disassemble_8xxx(i, opcode, output_stream);
-                break;
-            case 0x9: /* 0x9XY0, skip next instruction if VX != VY */
-                fprintf(output_stream, "ADDR %#04zx: SNE V[%X], V[%X]\n", i, X(opcode), Y(opcode));
-                break;
-            case 0xA: /* 0xANNN, set I to NNN */
-                fprintf(output_stream, "ADDR %#04zx: LD I, %#03x\n", i, NNN(opcode));
-                break;
-            case 0xB: /* 0xBNNN, jump to address NNN + V0 */
-                fprintf(output_stream, "ADDR %#04zx: JP V[0], %#03x\n", i, NNN(opcode));
-                break;
-            case 0xC: /* 0xCXNN, set VX to random number & NN */
-                fprintf(output_stream, "ADDR %#04zx: RND V[%X], %#02x\n", i, X(opcode), NN(opcode));
-                break;
-            case 0xD: /* 0xDXYN, draw sprite at (VX, VY) with N bytes of sprite data starting at I */
-                fprintf(output_stream, "ADDR %#04zx: DRW V[%X], V[%X], %#01x\n", i, X(opcode), Y(opcode), N(opcode));
-                break;
-            case 0xE: /* 0xEX??, Key ops */
-                chip8_disassemble_exxx(i, opcode, output_stream);
-                break;
-            case 0xF: /* 0xFX??, other misc ops */
-                chip8_disassemble_fxxx(i, opcode, output_stream);
-                break;
-            default: /* Unknown opcodes (note only original Chip8 opcodes are supported, some roms use more */
-                fprintf(output_stream, "ADDR %#04zx: UNKNOWN OPCODE\n", i);
-                break;
-        }
+    if (read != (size_t) file_size) {
+        return CHIP8_ERROR_READ;
     }
-    free(memory);
+    return chip8_disassemble_memory(memory, read, output_stream);
 }
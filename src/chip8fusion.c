@@ -0,0 +1,215 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <chip8.h>
+
+/*
+ * Macro-op fusion. chip8_step() looks at the instructions at PC and, when
+ * they form one of the idioms below, executes the whole idiom in a single
+ * call instead of dispatching every instruction through chip8_cycle().
+ * Which idiom starts at an address is decoded once and cached in
+ * chip8->decoded. Fx33 and Fx55 invalidate the entries their stores can
+ * change, so code that rewrites itself is never run from a stale decode,
+ * and the timers still tick once per retired instruction. Architectural
+ * state after a step is exactly what the same number of chip8_cycle()
+ * calls produces.
+ */
+
+/* Longest idiom is three instructions */
+#define FUSION_WINDOW 6
+
+/* Entries of chip8->decoded */
+enum FusionKind {
+    FUSION_UNDECODED = CHIP8_DECODED_UNKNOWN,
+    FUSION_NONE = CHIP8_DECODED_PLAIN,
+    FUSION_LOAD_DRAW,
+    FUSION_LOADS,
+    FUSION_BCD_LOAD,
+    FUSION_LOOP
+};
+
+/* Upper bound on registers set by one fused LD chain */
+#define FUSION_MAX_LOADS 16
+
+static inline uint16_t peek(const struct Chip8 *chip8, uint16_t address) {
+    return chip8->memory[address] << 8 | chip8->memory[address + 1];
+}
+
+/* Annn, Dxyn: point I at a sprite and draw it */
+static unsigned fuse_load_draw(struct Chip8 *chip8, uint16_t first,
+                               uint16_t second) {
+    chip8->regs.PC += 4;
+    chip8->regs.I = first & 0x0FFF;
+    chip8_execute(chip8, second);
+    chip8_timers(chip8);
+    chip8_timers(chip8);
+    return 2;
+}
+
+/* A run of 6xnn register initializations */
+static unsigned fuse_loads(struct Chip8 *chip8, unsigned budget) {
+    unsigned count = 0;
+    uint16_t pc = chip8->regs.PC;
+
+    while (count < budget && count < FUSION_MAX_LOADS &&
+           pc <= CHIP8_MEMORY_SIZE - 2 && (chip8->memory[pc] & 0xF0) == 0x60) {
+        chip8->regs.V[chip8->memory[pc] & 0x0F] = chip8->memory[pc + 1];
+        chip8_timers(chip8);
+        pc += 2;
+        count++;
+    }
+    chip8->regs.PC = pc;
+    return count;
+}
+
+/* Fx33, Fx65: BCD a register and read the digits back */
+static unsigned fuse_bcd_load(struct Chip8 *chip8, uint16_t first) {
+    chip8->regs.PC += 2;
+    chip8_execute(chip8, first);
+    chip8_timers(chip8);
+
+    /* The BCD store may have overwritten the second instruction */
+    uint16_t second = peek(chip8, chip8->regs.PC);
+    if ((second & 0xF0FF) != 0xF065) {
+        return 1;
+    }
+    chip8->regs.PC += 2;
+    chip8_execute(chip8, second);
+    chip8_timers(chip8);
+    return 2;
+}
+
+/*
+ * Loops of the form
+ *     loop: Fx07 or 7xnn
+ *           3xkk
+ *           1nnn loop
+ * i.e. waiting for the delay timer or counting a register up to kk. Each
+ * iteration retires three instructions, the final one two. Iterations run
+ * until the skip is taken or the budget cannot fit another iteration.
+ */
+static unsigned fuse_loop(struct Chip8 *chip8, uint16_t first, uint16_t test,
+                          unsigned budget) {
+    uint8_t *vx = &chip8->regs.V[(first & 0x0F00) >> 8];
+    uint8_t target = test & 0x00FF;
+    bool delay = (first & 0xF000) == 0xF000;
+    uint16_t loop = chip8->regs.PC;
+    unsigned count = 0;
+
+    while (budget - count >= 3) {
+        if (delay) {
+            *vx = chip8->regs.DT;
+        } else {
+            *vx += first & 0x00FF;
+        }
+        chip8_timers(chip8);
+        chip8_timers(chip8);
+        if (*vx == target) {
+            chip8->regs.PC = loop + 6;
+            return count + 2;
+        }
+        chip8_timers(chip8);
+        count += 3;
+    }
+    return count;
+}
+
+/* Finds the idiom starting at pc, which leaves FUSION_WINDOW bytes */
+static uint8_t decode(const struct Chip8 *chip8, uint16_t pc) {
+    uint16_t first = peek(chip8, pc);
+    uint16_t second = peek(chip8, pc + 2);
+    uint16_t third = peek(chip8, pc + 4);
+
+    switch (first & 0xF000) {
+        case 0xA000:
+            if ((second & 0xF000) == 0xD000) {
+                return FUSION_LOAD_DRAW;
+            }
+            break;
+        case 0x6000:
+            if ((second & 0xF000) == 0x6000) {
+                return FUSION_LOADS;
+            }
+            break;
+        case 0x7000:
+        case 0xF000:
+            if ((first & 0xF0FF) == 0xF033 && (second & 0xF0FF) == 0xF065) {
+                return FUSION_BCD_LOAD;
+            }
+            if (((first & 0xF000) == 0x7000 || (first & 0xF0FF) == 0xF007) &&
+                (second & 0xFF00) == (0x3000 | (first & 0x0F00)) &&
+                third == (0x1000 | pc)) {
+                return FUSION_LOOP;
+            }
+            break;
+        default:
+            break;
+    }
+    return FUSION_NONE;
+}
+
+/*
+ * Forgets cached decodes that depend on memory[address, address + size).
+ * An idiom reads up to FUSION_WINDOW bytes, so entries that start a few
+ * bytes earlier go too. Call after writing memory outside chip8_execute().
+ */
+void chip8_invalidate(struct Chip8 *chip8, uint16_t address, size_t size) {
+    if (size >= CHIP8_MEMORY_SIZE) {
+        memset(chip8->decoded, FUSION_UNDECODED, sizeof(chip8->decoded));
+        return;
+    }
+    for (size_t i = 0; i < size + FUSION_WINDOW - 1; i++) {
+        uint16_t start = address - (FUSION_WINDOW - 1) + i;
+        chip8->decoded[start & (CHIP8_MEMORY_SIZE - 1)] = FUSION_UNDECODED;
+    }
+}
+
+/* Runs one instruction or one fused idiom, returns instructions retired */
+unsigned chip8_step(struct Chip8 *chip8, unsigned budget) {
+    uint16_t pc = chip8->regs.PC;
+    unsigned retired = 0;
+
+    if (budget == 0) {
+        return 0;
+    }
+    /* Only near the end of memory, where fetches wrap */
+    if (pc > CHIP8_MEMORY_SIZE - FUSION_WINDOW) {
+        chip8_cycle(chip8);
+        return 1;
+    }
+
+    uint8_t kind = chip8->decoded[pc];
+    if (kind == FUSION_UNDECODED) {
+        kind = chip8->decoded[pc] = decode(chip8, pc);
+    }
+    /* Plain instructions go straight to the interpreter's own dispatch */
+    if (kind == FUSION_NONE || budget < 2) {
+        chip8_cycle(chip8);
+        return 1;
+    }
+
+    uint16_t first = peek(chip8, pc);
+    switch (kind) {
+        case FUSION_LOAD_DRAW:
+            retired = fuse_load_draw(chip8, first, peek(chip8, pc + 2));
+            break;
+        case FUSION_LOADS:
+            retired = fuse_loads(chip8, budget);
+            break;
+        case FUSION_BCD_LOAD:
+            retired = fuse_bcd_load(chip8, first);
+            break;
+        default:
+            retired = fuse_loop(chip8, first, peek(chip8, pc + 2), budget);
+            break;
+    }
+
+    /* A loop with too little budget left for one iteration */
+    if (retired == 0) {
+        chip8_cycle(chip8);
+        retired = 1;
+    }
+    return retired;
+}
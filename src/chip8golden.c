@@ -0,0 +1,549 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <chip8golden.h>
+#include <chip8search.h>
+
+/* Memory and display differences listed before the rest are summarized */
+#define DIFF_LIMIT 8
+
+static void reference_run(struct Chip8 *chip8, unsigned long cycles,
+                          void *user_data) {
+    (void) user_data;
+    while (cycles-- > 0) {
+        chip8_cycle(chip8);
+    }
+}
+
+static void fused_run(struct Chip8 *chip8, unsigned long cycles,
+                      void *user_data) {
+    (void) user_data;
+    chip8_run(chip8, cycles);
+}
+
+static void native_run(struct Chip8 *chip8, unsigned long cycles,
+                       void *user_data) {
+    chip8_native_run(user_data, chip8, cycles);
+}
+
+/* The dispatch table was checked against another state's memory */
+static void native_reset(void *user_data) {
+    struct Chip8Native *native = user_data;
+    native->validated = false;
+}
+
+const struct Chip8GoldenEngine chip8_golden_reference = {
+        "reference", reference_run, NULL, NULL};
+const struct Chip8GoldenEngine chip8_golden_fused = {
+        "fused", fused_run, NULL, NULL};
+
+void chip8_golden_native(struct Chip8GoldenEngine *engine,
+                         struct Chip8Native *native) {
+    engine->name = "native";
+    engine->run = native_run;
+    engine->reset = native_reset;
+    engine->user_data = native;
+}
+
+void chip8_golden_init(struct Chip8Golden *golden, unsigned cycles_per_frame) {
+    golden->cycles_per_frame = cycles_per_frame;
+    golden->frames = 0;
+    golden->hashes = NULL;
+    golden->inputs = NULL;
+    golden->input_count = 0;
+}
+
+void chip8_golden_free(struct Chip8Golden *golden) {
+    free(golden->hashes);
+    free(golden->inputs);
+    golden->hashes = NULL;
+    golden->inputs = NULL;
+    golden->frames = 0;
+    golden->input_count = 0;
+}
+
+int chip8_golden_load_inputs(struct Chip8Golden *golden, const char *path) {
+    FILE *input = fopen(path, "r");
+    char line[128];
+    size_t capacity = 0;
+    int error = CHIP8_OK;
+
+    if (input == NULL) {
+        return CHIP8_ERROR_OPEN;
+    }
+
+    while (error == CHIP8_OK && fgets(line, sizeof(line), input) != NULL) {
+        struct Chip8GoldenInput event;
+        unsigned long frame;
+        unsigned key, pressed;
+        char *comment = strchr(line, '#');
+        char end;
+
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        if (sscanf(line, " %c", &end) != 1) {
+            continue; /* Blank */
+        }
+        if (sscanf(line, "%lu %x %u %c", &frame, &key, &pressed, &end) != 3 ||
+            key >= CHIP8_KEYPAD_SIZE || pressed > 1) {
+            error = CHIP8_ERROR_FORMAT;
+            break;
+        }
+        /* Replaying relies on the order, so it is not sorted here */
+        if (golden->input_count > 0 &&
+            frame < golden->inputs[golden->input_count - 1].frame) {
+            error = CHIP8_ERROR_FORMAT;
+            break;
+        }
+
+        if (golden->input_count == capacity) {
+            size_t grown = capacity ? capacity * 2 : 64;
+            struct Chip8GoldenInput *inputs =
+                    realloc(golden->inputs, grown * sizeof(*inputs));
+            if (inputs == NULL) {
+                error = CHIP8_ERROR_MEMORY;
+                break;
+            }
+            golden->inputs = inputs;
+            capacity = grown;
+        }
+        event.frame = frame;
+        event.key = key;
+        event.pressed = pressed;
+        golden->inputs[golden->input_count++] = event;
+    }
+
+    if (error == CHIP8_OK && ferror(input)) {
+        error = CHIP8_ERROR_READ;
+    }
+    fclose(input);
+    return error;
+}
+
+int chip8_golden_load(struct Chip8Golden *golden, const char *path) {
+    FILE *input = fopen(path, "r");
+    int version;
+    unsigned cycles_per_frame;
+    unsigned long frames;
+    uint64_t *hashes;
+
+    if (input == NULL) {
+        return CHIP8_ERROR_OPEN;
+    }
+    if (fscanf(input, "FCHIP8-GOLDEN %d %u %lu", &version, &cycles_per_frame,
+               &frames) != 3 ||
+        version != CHIP8_GOLDEN_VERSION || cycles_per_frame == 0 ||
+        frames == 0) {
+        fclose(input);
+        return CHIP8_ERROR_FORMAT;
+    }
+
+    hashes = calloc(frames, sizeof(*hashes));
+    if (hashes == NULL) {
+        fclose(input);
+        return CHIP8_ERROR_MEMORY;
+    }
+    for (unsigned long frame = 0; frame < frames; frame++) {
+        if (fscanf(input, "%" SCNx64, &hashes[frame]) != 1) {
+            free(hashes);
+            fclose(input);
+            return CHIP8_ERROR_FORMAT;
+        }
+    }
+    fclose(input);
+
+    free(golden->hashes);
+    golden->hashes = hashes;
+    golden->frames = frames;
+    golden->cycles_per_frame = cycles_per_frame;
+    return CHIP8_OK;
+}
+
+int chip8_golden_save(const struct Chip8Golden *golden, const char *path) {
+    FILE *output = fopen(path, "w");
+
+    if (output == NULL) {
+        return CHIP8_ERROR_OPEN;
+    }
+    fprintf(output, "FCHIP8-GOLDEN %d %u %lu\n", CHIP8_GOLDEN_VERSION,
+            golden->cycles_per_frame, golden->frames);
+    for (unsigned long frame = 0; frame < golden->frames; frame++) {
+        fprintf(output, "%016" PRIx64 "\n", golden->hashes[frame]);
+    }
+    if (ferror(output)) {
+        fclose(output);
+        return CHIP8_ERROR_WRITE;
+    }
+    return fclose(output) == 0 ? CHIP8_OK : CHIP8_ERROR_WRITE;
+}
+
+/* Applies the script up to and including frame, returns the next input */
+static size_t apply_inputs(const struct Chip8Golden *golden, size_t next,
+                           unsigned long frame, struct Chip8 *chip8) {
+    while (next < golden->input_count && golden->inputs[next].frame <= frame) {
+        const struct Chip8GoldenInput *event = &golden->inputs[next++];
+        chip8->keypad[event->key] = event->pressed;
+    }
+    return next;
+}
+
+int chip8_golden_record(struct Chip8Golden *golden, const struct Chip8 *initial,
+                        unsigned long frames) {
+    struct Chip8 chip8;
+    uint64_t *hashes;
+    size_t next = 0;
+
+    if (frames == 0 || golden->cycles_per_frame == 0) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    hashes = calloc(frames, sizeof(*hashes));
+    if (hashes == NULL) {
+        return CHIP8_ERROR_MEMORY;
+    }
+
+    chip8_fork(initial, &chip8);
+    for (unsigned long frame = 0; frame < frames; frame++) {
+        next = apply_inputs(golden, next, frame, &chip8);
+        reference_run(&chip8, golden->cycles_per_frame, NULL);
+        hashes[frame] = chip8_state_hash(&chip8);
+    }
+
+    free(golden->hashes);
+    golden->hashes = hashes;
+    golden->frames = frames;
+    return CHIP8_OK;
+}
+
+/*
+ * The frame starting from snapshot missed its golden hash. The snapshot
+ * matched the previous one, so replay it with the reference, one cycle
+ * further each time, until the engine's state differs.
+ */
+static void locate_divergence(const struct Chip8Golden *golden,
+                              const struct Chip8GoldenEngine *engine,
+                              const struct Chip8 *snapshot,
+                              unsigned long frame,
+                              struct Chip8GoldenResult *result) {
+    chip8_fork(snapshot, &result->expected);
+
+    for (unsigned cycle = 1; cycle <= golden->cycles_per_frame; cycle++) {
+        /* Read before it runs, it may rewrite itself */
+        uint16_t pc = result->expected.regs.PC & (CHIP8_MEMORY_SIZE - 2);
+        result->address = result->expected.regs.PC;
+        result->opcode = result->expected.memory[pc] << 8 |
+                         result->expected.memory[pc + 1];
+        reference_run(&result->expected, 1, NULL);
+
+        chip8_fork(snapshot, &result->actual);
+        if (engine->reset != NULL) {
+            engine->reset(engine->user_data);
+        }
+        engine->run(&result->actual, cycle, engine->user_data);
+
+        if (chip8_state_hash(&result->expected) !=
+            chip8_state_hash(&result->actual)) {
+            result->cycle = frame * golden->cycles_per_frame + cycle;
+            return;
+        }
+    }
+    result->cycle = (frame + 1) * golden->cycles_per_frame;
+    result->reference_agrees = true;
+}
+
+int chip8_golden_verify(const struct Chip8Golden *golden,
+                        const struct Chip8 *initial,
+                        const struct Chip8GoldenEngine *engine,
+                        struct Chip8GoldenResult *result) {
+    struct Chip8 chip8, snapshot;
+    size_t next = 0;
+
+    if (golden->hashes == NULL || golden->cycles_per_frame == 0 ||
+        engine == NULL || engine->run == NULL || result == NULL) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    result->diverged = false;
+    result->reference_agrees = false;
+    result->frame = golden->frames;
+    result->cycle = golden->frames * golden->cycles_per_frame;
+
+    chip8_fork(initial, &chip8);
+    if (engine->reset != NULL) {
+        engine->reset(engine->user_data);
+    }
+    for (unsigned long frame = 0; frame < golden->frames; frame++) {
+        next = apply_inputs(golden, next, frame, &chip8);
+        chip8_fork(&chip8, &snapshot);
+        engine->run(&chip8, golden->cycles_per_frame, engine->user_data);
+
+        if (chip8_state_hash(&chip8) != golden->hashes[frame]) {
+            result->diverged = true;
+            result->frame = frame;
+            locate_divergence(golden, engine, &snapshot, frame, result);
+            break;
+        }
+    }
+    return CHIP8_OK;
+}
+
+/* Prints up to DIFF_LIMIT runs of differing bytes */
+static void diff_bytes(const char *name, const uint8_t *expected,
+                       const uint8_t *actual, size_t size,
+                       FILE *output_stream) {
+    size_t runs = 0, bytes = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        size_t start = i;
+
+        if (expected[i] == actual[i]) {
+            continue;
+        }
+        while (i + 1 < size && expected[i + 1] != actual[i + 1]) {
+            i++;
+        }
+        bytes += i - start + 1;
+        if (runs++ >= DIFF_LIMIT) {
+            continue;
+        }
+        fprintf(output_stream, "  %s[0x%03zX..0x%03zX]:", name, start, i);
+        for (size_t j = start; j <= i && j < start + DIFF_LIMIT; j++) {
+            fprintf(output_stream, " %02X/%02X", expected[j], actual[j]);
+        }
+        fprintf(output_stream, i - start + 1 > DIFF_LIMIT ? " ...\n" : "\n");
+    }
+    if (runs > DIFF_LIMIT) {
+        fprintf(output_stream, "  %s: %zu bytes differ in %zu runs\n", name,
+                bytes, runs);
+    }
+}
+
+static void diff_value(const char *name, unsigned expected, unsigned actual,
+                       FILE *output_stream) {
+    if (expected != actual) {
+        fprintf(output_stream, "  %s: 0x%X/0x%X\n", name, expected, actual);
+    }
+}
+
+/* Everything that differs, printed as expected/actual */
+void chip8_golden_diff(const struct Chip8 *expected, const struct Chip8 *actual,
+                       FILE *output_stream) {
+    const struct Chip8Registers *a = &expected->regs, *b = &actual->regs;
+    char name[8];
+    size_t pixels = 0;
+
+    for (int i = 0; i < CHIP8_REGISTER_COUNT; i++) {
+        snprintf(name, sizeof(name), "V%X", i);
+        diff_value(name, a->V[i], b->V[i], output_stream);
+    }
+    diff_value("I", a->I, b->I, output_stream);
+    diff_value("PC", a->PC, b->PC, output_stream);
+    diff_value("SP", a->SP, b->SP, output_stream);
+    diff_value("DT", a->DT, b->DT, output_stream);
+    diff_value("ST", a->ST, b->ST, output_stream);
+    diff_value("RNG", expected->rng, actual->rng, output_stream);
+    for (int i = 0; i < CHIP8_STACK_SIZE; i++) {
+        snprintf(name, sizeof(name), "S%X", i);
+        diff_value(name, expected->stack[i], actual->stack[i], output_stream);
+    }
+    diff_bytes("memory", expected->memory, actual->memory, CHIP8_MEMORY_SIZE,
+               output_stream);
+
+    for (int i = 0; i < CHIP8_DISPLAY_SIZE; i++) {
+        if (expected->display[i] == actual->display[i]) {
+            continue;
+        }
+        if (pixels++ < DIFF_LIMIT) {
+            fprintf(output_stream, "  pixel (%d, %d): %u/%u\n",
+                    i % CHIP8_DISPLAY_WIDTH, i / CHIP8_DISPLAY_WIDTH,
+                    expected->display[i], actual->display[i]);
+        }
+    }
+    if (pixels > DIFF_LIMIT) {
+        fprintf(output_stream, "  display: %zu pixels differ\n", pixels);
+    }
+}
+
+/* Prints how engine fared, returns false if it diverged */
+bool chip8_golden_report(const char *rom, const struct Chip8Golden *golden,
+                         const struct Chip8GoldenEngine *engine,
+                         const struct Chip8GoldenResult *result,
+                         double seconds, FILE *output_stream) {
+    char disassembly[CHIP8_DISASSEMBLY_SIZE];
+
+    if (!result->diverged) {
+        fprintf(output_stream, "%s: %s: ok, %lu frames", rom, engine->name,
+                golden->frames);
+        if (seconds > 0) {
+            fprintf(output_stream, " (%.0f frames/s)",
+                    golden->frames / seconds);
+        }
+        fprintf(output_stream, "\n");
+        return true;
+    }
+
+    fprintf(output_stream, "%s: %s: diverged in frame %lu after %lu cycles\n",
+            rom, engine->name, result->frame, result->cycle);
+    if (result->reference_agrees) {
+        fprintf(output_stream,
+                "  matches chip8_cycle, the golden file is out of date\n");
+        return false;
+    }
+    chip8_disassemble_opcode(result->address & (CHIP8_MEMORY_SIZE - 2),
+                             result->opcode, disassembly, sizeof(disassembly));
+    fprintf(output_stream, "  last instruction %s\n", disassembly);
+    fprintf(output_stream, "  expected/actual:\n");
+    chip8_golden_diff(&result->expected, &result->actual, output_stream);
+    return false;
+}
+
+/* Verifies one engine and reports it, returns false on any failure */
+static bool list_check(const char *rom, const struct Chip8Golden *golden,
+                       const struct Chip8 *initial,
+                       const struct Chip8GoldenEngine *engine,
+                       struct Chip8GoldenResult *result,
+                       FILE *output_stream) {
+    clock_t start = clock();
+    int error = chip8_golden_verify(golden, initial, engine, result);
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    if (error != CHIP8_OK) {
+        fprintf(output_stream, "Error: %s: %s\n", rom, chip8_strerror(error));
+        return false;
+    }
+    return chip8_golden_report(rom, golden, engine, result, seconds,
+                               output_stream);
+}
+
+/* Records, or verifies every engine of, one list line */
+static unsigned long list_line(const char *line, bool record,
+                               unsigned long frames, unsigned cycles_per_frame,
+                               struct Chip8 *initial,
+                               struct Chip8Native *native,
+                               struct Chip8GoldenResult *result,
+                               FILE *output_stream) {
+    char rom[1024], golden_path[1024], inputs[1024], native_path[1024];
+    struct Chip8Golden golden;
+    const char *failed;
+    unsigned long failures = 0;
+    int fields;
+    int error;
+
+    fields = sscanf(line, "%1023s %1023s %1023s %1023s", rom, golden_path,
+                    inputs, native_path);
+    if (fields <= 0 || rom[0] == '#') {
+        return 0;
+    }
+    if (fields < 2) {
+        fprintf(output_stream, "Error: Expected a rom and a golden file: %s",
+                line);
+        return 1;
+    }
+
+    chip8_golden_init(&golden, cycles_per_frame);
+    chip8_init(initial);
+    failed = rom;
+    error = chip8_load(initial, rom);
+    if (error == CHIP8_OK && fields > 2 && strcmp(inputs, "-") != 0) {
+        failed = inputs;
+        error = chip8_golden_load_inputs(&golden, inputs);
+    }
+    if (error == CHIP8_OK) {
+        failed = golden_path;
+        error = record ? chip8_golden_record(&golden, initial, frames)
+                       : chip8_golden_load(&golden, golden_path);
+    }
+    if (error == CHIP8_OK && record) {
+        error = chip8_golden_save(&golden, golden_path);
+        if (error == CHIP8_OK) {
+            fprintf(output_stream, "%s: recorded %lu frames\n", rom,
+                    golden.frames);
+        }
+    }
+    if (error != CHIP8_OK) {
+        fprintf(output_stream, "Error: %s: %s\n", failed,
+                chip8_strerror(error));
+        chip8_golden_free(&golden);
+        return 1;
+    }
+    if (record) {
+        chip8_golden_free(&golden);
+        return 0;
+    }
+
+    /* The reference is checked too, it catches core regressions */
+    failures += !list_check(rom, &golden, initial, &chip8_golden_reference,
+                            result, output_stream);
+    failures += !list_check(rom, &golden, initial, &chip8_golden_fused,
+                            result, output_stream);
+    if (fields > 3) {
+        struct Chip8GoldenEngine engine;
+        error = chip8_native_open(native, native_path);
+        if (error != CHIP8_OK) {
+            fprintf(output_stream, "Error: %s: %s\n", native_path,
+                    chip8_strerror(error));
+            failures++;
+        } else {
+            chip8_golden_native(&engine, native);
+            failures += !list_check(rom, &golden, initial, &engine, result,
+                                    output_stream);
+            chip8_native_close(native);
+        }
+    }
+    chip8_golden_free(&golden);
+    return failures;
+}
+
+/*
+ * Runs a list of "rom golden [inputs|-] [rom.so]" lines, paths relative
+ * to the working directory. Recording saves frames of cycles_per_frame
+ * cycles for each rom, verifying checks the reference, fused and, if
+ * given, native engines. Failed lines and checks are counted in failures.
+ */
+int chip8_golden_list(const char *path, bool record, unsigned long frames,
+                      unsigned cycles_per_frame, FILE *output_stream,
+                      unsigned long *failures) {
+    FILE *list;
+    char line[4 * 1024];
+    struct Chip8 *initial;
+    struct Chip8Native *native;
+    struct Chip8GoldenResult *result;
+
+    if (path == NULL || failures == NULL || (record && frames == 0)) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    list = fopen(path, "r");
+    if (list == NULL) {
+        return CHIP8_ERROR_OPEN;
+    }
+    /* Too large to put on the stack together */
+    initial = malloc(sizeof(*initial));
+    native = malloc(sizeof(*native));
+    result = malloc(sizeof(*result));
+    if (initial == NULL || native == NULL || result == NULL) {
+        free(initial);
+        free(native);
+        free(result);
+        fclose(list);
+        return CHIP8_ERROR_MEMORY;
+    }
+
+    *failures = 0;
+    while (fgets(line, sizeof(line), list) != NULL) {
+        *failures += list_line(line, record, frames, cycles_per_frame, initial,
+                               native, result, output_stream);
+    }
+    if (ferror(list)) {
+        (*failures)++;
+    }
+
+    free(initial);
+    free(native);
+    free(result);
+    fclose(list);
+    return CHIP8_OK;
+}
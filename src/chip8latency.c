@@ -0,0 +1,135 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chip8latency.h>
+
+static void histogram_add(struct Chip8Histogram *histogram, uint64_t value) {
+    int bucket = 0;
+
+    while (bucket < CHIP8_LATENCY_BUCKETS - 1 && value >> (bucket + 1) != 0) {
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total += value;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+}
+
+void chip8_latency_init(struct Chip8Latency *latency) {
+    memset(latency, 0, sizeof(*latency));
+}
+
+/* A key went down in the frontend */
+void chip8_latency_key(struct Chip8Latency *latency, uint8_t key,
+                       uint64_t now) {
+    key &= CHIP8_KEYPAD_SIZE - 1;
+    latency->pending |= 1 << key;
+    latency->observed &= ~(1 << key);
+    latency->pressed_at[key] = now;
+    latency->pressed_cycle[key] = latency->cycle;
+}
+
+/*
+ * Call after running cycles instructions. Consumes chip8->keys_observed and
+ * records the read latency of every pending key the ROM read meanwhile.
+ */
+void chip8_latency_observe(struct Chip8Latency *latency, struct Chip8 *chip8,
+                           unsigned cycles, uint64_t now) {
+    uint16_t seen = latency->pending & chip8->keys_observed;
+
+    latency->cycle += cycles;
+    chip8->keys_observed = 0;
+
+    for (int key = 0; seen >> key != 0; key++) {
+        if (!(seen >> key & 1)) {
+            continue;
+        }
+        histogram_add(&latency->poll, now - latency->pressed_at[key]);
+        histogram_add(&latency->poll_cycles,
+                      latency->cycle - latency->pressed_cycle[key]);
+        latency->observed_at[key] = now;
+    }
+    latency->pending &= ~seen;
+    latency->observed |= seen;
+}
+
+/* Call right after presenting a frame that differs from the previous one */
+void chip8_latency_present(struct Chip8Latency *latency, uint64_t now) {
+    uint16_t shown = latency->observed;
+
+    for (int key = 0; shown >> key != 0; key++) {
+        if (!(shown >> key & 1)) {
+            continue;
+        }
+        histogram_add(&latency->present, now - latency->observed_at[key]);
+        histogram_add(&latency->total, now - latency->pressed_at[key]);
+    }
+    latency->observed = 0;
+}
+
+/* Upper bound of the bucket holding the given percentile, 0 if empty */
+uint64_t chip8_histogram_percentile(const struct Chip8Histogram *histogram,
+                                    double percentile) {
+    uint64_t rank = (uint64_t) (histogram->count * percentile / 100.0);
+    uint64_t seen = 0;
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+    for (int bucket = 0; bucket < CHIP8_LATENCY_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen > rank) {
+            uint64_t bound = ((uint64_t) 2 << bucket) - 1;
+            return bound < histogram->max ? bound : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+/* One line for a window title or status bar */
+int chip8_latency_summary(const struct Chip8Latency *latency, char *buffer,
+                          size_t buffer_size) {
+    if (buffer == NULL || buffer_size == 0) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    snprintf(buffer, buffer_size,
+             "input %.1f/%.1f ms, read %.1f ms, present %.1f ms (p50/p99, p50)",
+             chip8_histogram_percentile(&latency->total, 50) / 1000.0,
+             chip8_histogram_percentile(&latency->total, 99) / 1000.0,
+             chip8_histogram_percentile(&latency->poll, 50) / 1000.0,
+             chip8_histogram_percentile(&latency->present, 50) / 1000.0);
+    return CHIP8_OK;
+}
+
+static void histogram_print(const struct Chip8Histogram *histogram,
+                            const char *name, const char *unit, FILE *output) {
+    fprintf(output, "%s: %llu samples", name,
+            (unsigned long long) histogram->count);
+    if (histogram->count == 0) {
+        fprintf(output, "\n");
+        return;
+    }
+    fprintf(output, ", mean %llu %s, max %llu %s\n",
+            (unsigned long long) (histogram->total / histogram->count), unit,
+            (unsigned long long) histogram->max, unit);
+
+    for (int bucket = 0; bucket < CHIP8_LATENCY_BUCKETS; bucket++) {
+        if (histogram->buckets[bucket] == 0) {
+            continue;
+        }
+        fprintf(output, "  < %10llu %s: %llu\n",
+                (unsigned long long) ((uint64_t) 2 << bucket), unit,
+                (unsigned long long) histogram->buckets[bucket]);
+    }
+}
+
+void chip8_latency_print(const struct Chip8Latency *latency, FILE *output) {
+    histogram_print(&latency->poll, "Key event to ROM read", "us", output);
+    histogram_print(&latency->poll_cycles, "Key event to ROM read", "cycles",
+                    output);
+    histogram_print(&latency->present, "ROM read to present", "us", output);
+    histogram_print(&latency->total, "Key event to present", "us", output);
+}
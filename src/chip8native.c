@@ -0,0 +1,145 @@
+#include <dlfcn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <chip8native.h>
+
+/* Loads a compiled ROM built from chip8_compile() output */
+int chip8_native_open(struct Chip8Native *native, const char *path) {
+    memset(native, 0, sizeof(*native));
+
+    native->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (native->handle == NULL) {
+        return CHIP8_ERROR_OPEN;
+    }
+
+    native->module = dlsym(native->handle, CHIP8_NATIVE_SYMBOL);
+    if (native->module == NULL ||
+        native->module->abi_version != CHIP8_NATIVE_ABI_VERSION ||
+        native->module->chip8_size != sizeof(struct Chip8)) {
+        chip8_native_close(native);
+        return CHIP8_ERROR_FORMAT;
+    }
+    native->module->execute = chip8_execute;
+
+    /* Only jumps to odd addresses make blocks overlap */
+    for (uint16_t i = 0; i < native->module->block_count; i++) {
+        const struct Chip8NativeBlock *block = &native->module->blocks[i];
+        for (int address = block->start;
+             block->function != NULL && address < block->start + block->length &&
+             address < CHIP8_MEMORY_SIZE;
+             address++) {
+            native->overlapping |= native->owners[address] != NULL;
+            native->owners[address] = block;
+        }
+    }
+    return CHIP8_OK;
+}
+
+void chip8_native_close(struct Chip8Native *native) {
+    if (native->handle != NULL) {
+        dlclose(native->handle);
+    }
+    native->handle = NULL;
+    native->module = NULL;
+}
+
+/* Enables a block only while its code in memory matches the ROM */
+static void validate_block(struct Chip8Native *native, const struct Chip8 *chip8,
+                           const struct Chip8NativeBlock *block) {
+    const uint8_t *code = native->module->rom + block->start - CHIP8_START_ADDRESS;
+    bool valid = block->start + block->length <= CHIP8_MEMORY_SIZE &&
+                 memcmp(chip8->memory + block->start, code, block->length) == 0;
+
+    native->table[block->start] = valid ? block : NULL;
+}
+
+/*
+ * Enables exactly the blocks whose code in memory still matches the ROM
+ * they were compiled from. Called before the first run and whenever the
+ * state may have come from somewhere else, so rewritten code falls back
+ * to the interpreter.
+ */
+void chip8_native_validate(struct Chip8Native *native,
+                           const struct Chip8 *chip8) {
+    const struct Chip8NativeModule *module = native->module;
+
+    memset(native->table, 0, sizeof(native->table));
+    for (uint16_t i = 0; i < module->block_count; i++) {
+        if (module->blocks[i].function != NULL) {
+            validate_block(native, chip8, &module->blocks[i]);
+        }
+    }
+    native->validated = true;
+}
+
+/* Rechecks only the blocks covering the size bytes just stored at I */
+static void validate_write(struct Chip8Native *native, const struct Chip8 *chip8,
+                           unsigned size) {
+    const struct Chip8NativeBlock *last = NULL;
+
+    if (native->overlapping) {
+        chip8_native_validate(native, chip8);
+        return;
+    }
+    for (unsigned i = 0; i < size; i++) {
+        const struct Chip8NativeBlock *block =
+                native->owners[(chip8->regs.I + i) & (CHIP8_MEMORY_SIZE - 1)];
+        if (block != NULL && block != last) {
+            validate_block(native, chip8, block);
+            last = block;
+        }
+    }
+}
+
+/* Bytes an Fx33 or Fx55 stores from I, 0 for every other opcode */
+static unsigned write_size(uint16_t opcode) {
+    switch (opcode & 0xF0FF) {
+        case 0xF033:
+            return 3;
+        case 0xF055:
+            return ((opcode & 0x0F00) >> 8) + 1;
+        default:
+            return 0;
+    }
+}
+
+/* Runs exactly the given number of instructions */
+void chip8_native_run(struct Chip8Native *native, struct Chip8 *chip8,
+                      unsigned long cycles) {
+    if (!native->validated) {
+        chip8_native_validate(native, chip8);
+    }
+
+    while (cycles > 0) {
+        const struct Chip8NativeBlock *block =
+                chip8->regs.PC < CHIP8_MEMORY_SIZE ? native->table[chip8->regs.PC]
+                                                   : NULL;
+        unsigned written;
+
+        if (block != NULL && block->cycles <= cycles) {
+            /* A write always ends its block, so it is the last opcode */
+            const uint8_t *last = native->module->rom + block->start +
+                                  block->length - 2 - CHIP8_START_ADDRESS;
+            written = block->writes_memory ? write_size(last[0] << 8 | last[1]) : 0;
+            block->function(chip8);
+            cycles -= block->cycles;
+        } else {
+            /* Interpreter fallback, a fused BCD idiom starts with Fx33 */
+            uint16_t pc = chip8->regs.PC & (CHIP8_MEMORY_SIZE - 1);
+            written = write_size(chip8->memory[pc] << 8 |
+                                 chip8->memory[(pc + 1) & (CHIP8_MEMORY_SIZE - 1)]);
+            if (chip8->decoded[pc] == CHIP8_DECODED_PLAIN) {
+                chip8_cycle(chip8);
+                cycles--;
+            } else {
+                cycles -= chip8_step(chip8, cycles > 0xFFFF ? 0xFFFF : cycles);
+            }
+        }
+
+        if (written > 0) {
+            validate_write(native, chip8, written);
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <chip8phosphor.h>
+
+/* Blends channel by channel from background to foreground */
+static uint32_t blend(uint32_t background, uint32_t foreground,
+                      unsigned intensity) {
+    uint32_t color = 0xFF000000;
+
+    for (int shift = 0; shift < 24; shift += 8) {
+        unsigned from = (background >> shift) & 0xFF;
+        unsigned to = (foreground >> shift) & 0xFF;
+        unsigned channel = (from * (255 - intensity) + to * intensity + 127) / 255;
+        color |= (uint32_t) channel << shift;
+    }
+    return color;
+}
+
+/* Colors are 0xRRGGBB, decay is the fraction kept per frame out of 256 */
+void chip8_phosphor_init(struct Chip8Phosphor *phosphor, uint8_t decay,
+                         uint32_t background, uint32_t foreground) {
+    memset(phosphor->intensity, 0, sizeof(phosphor->intensity));
+    for (int i = 0; i < 256; i++) {
+        phosphor->palette[i] = blend(background, foreground, i);
+    }
+    for (int i = 0; i < CHIP8_DISPLAY_SIZE; i++) {
+        phosphor->pixels[i] = phosphor->palette[0];
+    }
+    phosphor->decay = decay;
+    phosphor->active = false;
+}
+
+/*
+ * intensity = max(lit ? 255 : 0, intensity * decay >> 8), returns non-zero
+ * if any pixel has not settled on its lit/unlit value yet. All three
+ * versions produce identical results. The loads are unaligned so a
+ * heap allocated struct Chip8Phosphor works too.
+ */
+#if defined(__AVX2__)
+static bool decay_blend(uint8_t *intensity, const uint8_t *display,
+                        uint8_t decay) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8((char) 0xFF);
+    const __m256i factor = _mm256_set1_epi16(decay);
+    __m256i unsettled = zero;
+
+    for (int i = 0; i < CHIP8_DISPLAY_SIZE; i += 32) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i *) (display + i));
+        __m256i lit = _mm256_andnot_si256(_mm256_cmpeq_epi8(pixels, zero), ones);
+        __m256i old = _mm256_loadu_si256((const __m256i *) (intensity + i));
+        __m256i low = _mm256_srli_epi16(
+                _mm256_mullo_epi16(_mm256_unpacklo_epi8(old, zero), factor), 8);
+        __m256i high = _mm256_srli_epi16(
+                _mm256_mullo_epi16(_mm256_unpackhi_epi8(old, zero), factor), 8);
+        __m256i value = _mm256_max_epu8(lit, _mm256_packus_epi16(low, high));
+        _mm256_storeu_si256((__m256i *) (intensity + i), value);
+        unsettled = _mm256_or_si256(unsettled, _mm256_xor_si256(value, lit));
+    }
+    return !_mm256_testz_si256(unsettled, unsettled);
+}
+#elif defined(__SSE2__)
+static bool decay_blend(uint8_t *intensity, const uint8_t *display,
+                        uint8_t decay) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8((char) 0xFF);
+    const __m128i factor = _mm_set1_epi16(decay);
+    __m128i unsettled = zero;
+
+    for (int i = 0; i < CHIP8_DISPLAY_SIZE; i += 16) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (display + i));
+        __m128i lit = _mm_andnot_si128(_mm_cmpeq_epi8(pixels, zero), ones);
+        __m128i old = _mm_loadu_si128((const __m128i *) (intensity + i));
+        __m128i low = _mm_srli_epi16(
+                _mm_mullo_epi16(_mm_unpacklo_epi8(old, zero), factor), 8);
+        __m128i high = _mm_srli_epi16(
+                _mm_mullo_epi16(_mm_unpackhi_epi8(old, zero), factor), 8);
+        __m128i value = _mm_max_epu8(lit, _mm_packus_epi16(low, high));
+        _mm_storeu_si128((__m128i *) (intensity + i), value);
+        unsettled = _mm_or_si128(unsettled, _mm_xor_si128(value, lit));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(unsettled, zero)) != 0xFFFF;
+}
+#else
+static bool decay_blend(uint8_t *intensity, const uint8_t *display,
+                        uint8_t decay) {
+    uint8_t unsettled = 0;
+
+    for (int i = 0; i < CHIP8_DISPLAY_SIZE; i++) {
+        uint8_t lit = display[i] ? 0xFF : 0x00;
+        uint8_t faded = (intensity[i] * decay) >> 8;
+        intensity[i] = faded > lit ? faded : lit;
+        unsettled |= intensity[i] ^ lit;
+    }
+    return unsettled != 0;
+}
+#endif
+
+/* Blends one frame of the display in and refreshes the ARGB pixels */
+void chip8_phosphor_update(struct Chip8Phosphor *phosphor,
+                           const uint8_t *display) {
+    phosphor->active = decay_blend(phosphor->intensity, display, phosphor->decay);
+
+    for (int i = 0; i < CHIP8_DISPLAY_SIZE; i++) {
+        phosphor->pixels[i] = phosphor->palette[phosphor->intensity[i]];
+    }
+}
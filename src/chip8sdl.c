@@ -1,4 +1,6 @@
 
+#include <string.h>
+
 #include <chip8.h>
 #include <chip8sdl.h>
 
@@ -36,10 +38,25 @@ int sdl_chip8_init(struct SDLChip8 *sdl_chip8, int window_scale) {
     }
 
     sdl_chip8->window_scale = window_scale;
+    sdl_chip8->phosphor = NULL;
+    sdl_chip8->last_present = 0;
+    sdl_chip8->latency = NULL;
+    /* The window starts out as a blank display */
+    static const uint8_t blank[CHIP8_DISPLAY_SIZE];
+    sdl_chip8->presented_hash = chip8_hash(blank, sizeof(blank));
 
     return 0;
 }
 
+/* Monotonic clock for latency measurements */
+uint64_t sdl_chip8_microseconds(void) {
+    Uint64 counter = SDL_GetPerformanceCounter();
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+
+    return counter / frequency * 1000000 +
+           counter % frequency * 1000000 / frequency;
+}
+
 void sdl_chip8_destroy(struct SDLChip8 *sdl_chip8) {
     SDL_DestroyTexture(sdl_chip8->texture);
     SDL_DestroyRenderer(sdl_chip8->renderer);
@@ -47,10 +64,25 @@ void sdl_chip8_destroy(struct SDLChip8 *sdl_chip8) {
     SDL_Quit();
 }
 
+/* Starts timing keys that just went down, key repeats are ignored */
+static void sdl_chip8_latency_keys(struct SDLChip8 *sdl_chip8,
+                                   const struct Chip8 *chip8,
+                                   const uint8_t *keypad) {
+    uint64_t now = sdl_chip8_microseconds();
+
+    for (int key = 0; key < CHIP8_KEYPAD_SIZE; key++) {
+        if (chip8->keypad[key] && !keypad[key]) {
+            chip8_latency_key(sdl_chip8->latency, key, now);
+        }
+    }
+}
+
 bool sdl_chip8_events(struct SDLChip8 *sdl_chip8, struct Chip8 *chip8) {
     bool quit = false;
+    uint8_t keypad[CHIP8_KEYPAD_SIZE];
 
     while (SDL_PollEvent(&sdl_chip8->event)) {
+        memcpy(keypad, chip8->keypad, sizeof(keypad));
         switch (sdl_chip8->event.type) {
             case SDL_QUIT:
                 quit = true;
@@ -109,6 +141,9 @@ bool sdl_chip8_events(struct SDLChip8 *sdl_chip8, struct Chip8 *chip8) {
                         quit = true;
                         break;
                 }
+                if (sdl_chip8->latency != NULL) {
+                    sdl_chip8_latency_keys(sdl_chip8, chip8, keypad);
+                }
                 break;
             case SDL_KEYUP:
                 switch (sdl_chip8->event.key.keysym.sym) {
@@ -166,3 +201,88 @@ bool sdl_chip8_events(struct SDLChip8 *sdl_chip8, struct Chip8 *chip8) {
     }
     return quit;
 }
+
+/*
+ * Latency only counts frames that show something new. ROMs often redraw
+ * the same picture, so draw_flag alone would end the measurement early.
+ */
+static void sdl_chip8_presented(struct SDLChip8 *sdl_chip8,
+                                const struct Chip8 *chip8) {
+    uint64_t hash;
+
+    if (sdl_chip8->latency == NULL) {
+        return;
+    }
+    hash = chip8_hash(chip8->display, sizeof(chip8->display));
+    if (hash != sdl_chip8->presented_hash) {
+        sdl_chip8->presented_hash = hash;
+        chip8_latency_present(sdl_chip8->latency, sdl_chip8_microseconds());
+    }
+}
+
+/*
+ * Phosphor frames are blended at a fixed 60 Hz so the fade speed does not
+ * depend on how often the main loop runs, and keep being presented until
+ * every pixel has settled. The texture is 64x32, scaling is left to the
+ * renderer.
+ */
+static bool sdl_chip8_draw_phosphor(struct SDLChip8 *sdl_chip8,
+                                    struct Chip8 *chip8) {
+    struct Chip8Phosphor *phosphor = sdl_chip8->phosphor;
+    Uint32 now = SDL_GetTicks();
+    bool changed = chip8->draw_flag;
+
+    if (!chip8->draw_flag && !phosphor->active) {
+        return false;
+    }
+    if (now - sdl_chip8->last_present < 1000 / 60) {
+        return false;
+    }
+
+    chip8_phosphor_update(phosphor, chip8->display);
+    SDL_UpdateTexture(sdl_chip8->texture, NULL, phosphor->pixels,
+                      CHIP8_DISPLAY_WIDTH * sizeof(uint32_t));
+    SDL_RenderClear(sdl_chip8->renderer);
+    SDL_RenderCopy(sdl_chip8->renderer, sdl_chip8->texture, NULL, NULL);
+    SDL_RenderPresent(sdl_chip8->renderer);
+    if (changed) {
+        sdl_chip8_presented(sdl_chip8, chip8);
+    }
+
+    sdl_chip8->last_present = now;
+    chip8->draw_flag = false;
+    return true;
+}
+
+/* Returns true if a frame was presented */
+bool sdl_chip8_draw(struct SDLChip8 *sdl_chip8, struct Chip8 *chip8) {
+    SDL_Renderer *renderer = sdl_chip8->renderer;
+    int window_scale = sdl_chip8->window_scale;
+
+    if (sdl_chip8->phosphor != NULL) {
+        return sdl_chip8_draw_phosphor(sdl_chip8, chip8);
+    }
+
+    if (!chip8->draw_flag) {
+        return false;
+    }
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+
+    for (int y = 0; y < 32; y++) {
+        for (int x = 0; x < 64; x++) {
+            if (chip8->display[(y * 64) + x] == 1) {
+                SDL_Rect rect = {x * window_scale, y * window_scale, window_scale,
+                                 window_scale};
+                SDL_RenderFillRect(renderer, &rect);
+            }
+        }
+    }
+    SDL_RenderPresent(renderer);
+    sdl_chip8_presented(sdl_chip8, chip8);
+    chip8->draw_flag = false;
+    return true;
+}
@@ -0,0 +1,323 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chip8search.h>
+
+struct SearchNode {
+    struct Chip8 chip8;
+    uint64_t hash;
+    long score;
+};
+
+/* How a kept state was reached, one per beam slot per step */
+struct SearchStep {
+    int parent;
+    uint8_t input;
+};
+
+/* Sortable summary of a child, keeps qsort free of global context */
+struct SearchRank {
+    uint64_t hash;
+    long score;
+    int index;
+};
+
+/* Work shared between the workers of one step */
+struct SearchLevel {
+    const struct Chip8SearchOptions *options;
+    const struct SearchNode *beam;
+    struct SearchNode *children;
+    int child_count;
+    atomic_int next;
+};
+
+/* Workers started once per search and handed one level at a time */
+struct SearchPool {
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    struct SearchLevel *level;
+    unsigned generation; /* Bumped for every level handed out */
+    int busy;            /* Workers still expanding the current level */
+    bool stop;
+    pthread_t *threads;
+    int started;
+};
+
+/* Compares the fields chip8_state_hash() covers */
+static bool same_state(const struct Chip8 *a, const struct Chip8 *b) {
+    return memcmp(a->regs.V, b->regs.V, sizeof(a->regs.V)) == 0 &&
+           a->regs.I == b->regs.I && a->regs.PC == b->regs.PC &&
+           a->regs.SP == b->regs.SP && a->regs.DT == b->regs.DT &&
+           a->regs.ST == b->regs.ST && a->rng == b->rng &&
+           memcmp(a->stack, b->stack, sizeof(a->stack)) == 0 &&
+           memcmp(a->display, b->display, sizeof(a->display)) == 0 &&
+           memcmp(a->memory, b->memory, sizeof(a->memory)) == 0;
+}
+
+/* Hashes the architectural state field by field, skipping padding */
+uint64_t chip8_state_hash(const struct Chip8 *chip8) {
+    const struct Chip8Registers *regs = &chip8->regs;
+    uint8_t scalars[7] = {regs->I >> 8, regs->I & 0xFF, regs->PC >> 8,
+                          regs->PC & 0xFF, regs->SP, regs->DT, regs->ST};
+    uint64_t parts[6] = {
+            chip8_hash(regs->V, sizeof(regs->V)),
+            chip8_hash(scalars, sizeof(scalars)),
+            chip8_hash(chip8->memory, sizeof(chip8->memory)),
+            chip8_hash(chip8->stack, sizeof(chip8->stack)),
+            chip8_hash(chip8->display, sizeof(chip8->display)),
+            chip8_hash(&chip8->rng, sizeof(chip8->rng))};
+    return chip8_hash(parts, sizeof(parts));
+}
+
+/* Child i is beam state i / CHIP8_SEARCH_INPUTS with input i % ... held */
+static void expand_child(struct SearchLevel *level, int i) {
+    const struct Chip8SearchOptions *options = level->options;
+    struct SearchNode *child = &level->children[i];
+    int input = i % CHIP8_SEARCH_INPUTS;
+
+    chip8_fork(&level->beam[i / CHIP8_SEARCH_INPUTS].chip8, &child->chip8);
+    memset(child->chip8.keypad, 0, CHIP8_KEYPAD_SIZE);
+    if (input < CHIP8_KEYPAD_SIZE) {
+        child->chip8.keypad[input] = 1;
+    }
+
+    chip8_run(&child->chip8, options->cycles_per_step);
+
+    child->hash = chip8_state_hash(&child->chip8);
+    child->score = options->score(&child->chip8, options->user_data);
+}
+
+static void expand_children(struct SearchLevel *level) {
+    int i;
+
+    while ((i = atomic_fetch_add(&level->next, 1)) < level->child_count) {
+        expand_child(level, i);
+    }
+}
+
+static void *search_worker(void *argument) {
+    struct SearchPool *pool = argument;
+    unsigned generation = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->stop && pool->generation == generation) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop) {
+            break;
+        }
+        generation = pool->generation;
+        struct SearchLevel *level = pool->level;
+        pthread_mutex_unlock(&pool->lock);
+
+        expand_children(level);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/* Groups equal states together, earliest child first */
+static int compare_hash(const void *a, const void *b) {
+    const struct SearchRank *left = a, *right = b;
+    if (left->hash != right->hash) {
+        return left->hash < right->hash ? -1 : 1;
+    }
+    return left->index - right->index;
+}
+
+/* Best score first, ties keep expansion order so results are stable */
+static int compare_score(const void *a, const void *b) {
+    const struct SearchRank *left = a, *right = b;
+    if (left->score != right->score) {
+        return left->score > right->score ? -1 : 1;
+    }
+    return left->index - right->index;
+}
+
+/* Starts threads - 1 workers, the calling thread is the last one */
+static int pool_start(struct SearchPool *pool, int threads) {
+    pool->level = NULL;
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->stop = false;
+    pool->started = 0;
+    pool->threads = NULL;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    if (threads <= 1) {
+        return CHIP8_OK;
+    }
+    pool->threads = malloc(sizeof(*pool->threads) * (threads - 1));
+    if (pool->threads == NULL) {
+        return CHIP8_ERROR_MEMORY;
+    }
+    /* Fewer workers than asked for only makes the search slower */
+    while (pool->started < threads - 1 &&
+           pthread_create(&pool->threads[pool->started], NULL, search_worker,
+                          pool) == 0) {
+        pool->started++;
+    }
+    return CHIP8_OK;
+}
+
+static void pool_stop(struct SearchPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->started; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    free(pool->threads);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+/* Expands every child of the beam, spread over the pool */
+static void expand_level(struct SearchPool *pool, struct SearchLevel *level) {
+    atomic_store(&level->next, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->level = level;
+    pool->busy = pool->started;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    expand_children(level);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* True if child index is a state already kept among ranks[0..unique) */
+static bool is_duplicate(const struct SearchRank *ranks, int unique,
+                         const struct SearchNode *children, int index) {
+    for (int j = unique - 1; j >= 0 && ranks[j].hash == children[index].hash;
+         j--) {
+        if (same_state(&children[ranks[j].index].chip8,
+                       &children[index].chip8)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Beam search over keypad inputs starting from root. Every step forks each
+ * kept state once per input, runs it, drops duplicate states and keeps
+ * the beam_width best scores. On success inputs holds the *length inputs
+ * (at most depth) leading to the best state seen and *score its score.
+ */
+int chip8_search(const struct Chip8 *root,
+                 const struct Chip8SearchOptions *options, uint8_t *inputs,
+                 int *length, long *score) {
+    int width = options->beam_width;
+    int depth = options->depth;
+
+    if (width < 1 || depth < 1 || options->cycles_per_step < 0 ||
+        options->score == NULL) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    int max_children = width * CHIP8_SEARCH_INPUTS;
+    struct SearchNode *beam = malloc(sizeof(*beam) * width);
+    struct SearchNode *children = malloc(sizeof(*children) * max_children);
+    struct SearchRank *ranks = malloc(sizeof(*ranks) * max_children);
+    struct SearchStep *history = malloc(sizeof(*history) * width * depth);
+
+    struct SearchPool pool;
+    int error = pool_start(&pool, options->threads);
+
+    if (beam == NULL || children == NULL || ranks == NULL || history == NULL ||
+        error != CHIP8_OK) {
+        pool_stop(&pool);
+        free(beam);
+        free(children);
+        free(ranks);
+        free(history);
+        return CHIP8_ERROR_MEMORY;
+    }
+
+    int beam_size = 1;
+    chip8_fork(root, &beam[0].chip8);
+
+    int best_step = -1, best_index = 0;
+    long best_score = 0;
+
+    for (int step = 0; step < depth; step++) {
+        struct SearchLevel level = {
+                .options = options,
+                .beam = beam,
+                .children = children,
+                .child_count = beam_size * CHIP8_SEARCH_INPUTS};
+        expand_level(&pool, &level);
+
+        /* Drop duplicate states, keeping the first one reached */
+        for (int i = 0; i < level.child_count; i++) {
+            ranks[i] = (struct SearchRank) {children[i].hash,
+                                            children[i].score, i};
+        }
+        qsort(ranks, level.child_count, sizeof(*ranks), compare_hash);
+        int unique = 0;
+        for (int i = 0; i < level.child_count; i++) {
+            if (!is_duplicate(ranks, unique, children, ranks[i].index)) {
+                ranks[unique++] = ranks[i];
+            }
+        }
+        if (options->duplicates != NULL) {
+            *options->duplicates += level.child_count - unique;
+        }
+
+        /* Keep the best scoring states as the next beam */
+        qsort(ranks, unique, sizeof(*ranks), compare_score);
+        beam_size = unique < width ? unique : width;
+        for (int i = 0; i < beam_size; i++) {
+            int index = ranks[i].index;
+            history[step * width + i] = (struct SearchStep) {
+                    index / CHIP8_SEARCH_INPUTS, index % CHIP8_SEARCH_INPUTS};
+            beam[i] = children[index];
+        }
+
+        if (best_step < 0 || beam[0].score > best_score) {
+            best_step = step;
+            best_index = 0;
+            best_score = beam[0].score;
+        }
+    }
+
+    /* Walk the history back from the best state to recover its inputs */
+    for (int step = best_step, index = best_index; step >= 0; step--) {
+        struct SearchStep *entry = &history[step * width + index];
+        inputs[step] = entry->input < CHIP8_KEYPAD_SIZE ? entry->input
+                                                        : CHIP8_SEARCH_NO_KEY;
+        index = entry->parent;
+    }
+    *length = best_step + 1;
+    *score = best_score;
+
+    pool_stop(&pool);
+    free(beam);
+    free(children);
+    free(ranks);
+    free(history);
+    return CHIP8_OK;
+}
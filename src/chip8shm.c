@@ -0,0 +1,156 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chip8shm.h>
+
+/* Opens and maps a segment, creating and sizing it if create is set */
+static int shm_map(struct Chip8SharedMemory *handle, const char *name,
+                   bool create) {
+    memset(handle, 0, sizeof(*handle));
+
+    /* POSIX wants the name to start with a slash */
+    snprintf(handle->name, sizeof(handle->name), "%s%s",
+             name[0] == '/' ? "" : "/", name);
+
+    int fd = shm_open(handle->name, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR,
+                      0600);
+    if (fd < 0) {
+        /* Likely left behind by an emulator that crashed */
+        return create && errno == EEXIST ? CHIP8_ERROR_EXISTS
+                                         : CHIP8_ERROR_OPEN;
+    }
+
+    if (create && ftruncate(fd, sizeof(struct Chip8Shm)) != 0) {
+        close(fd);
+        shm_unlink(handle->name);
+        return CHIP8_ERROR_MEMORY;
+    }
+
+    void *address = mmap(NULL, sizeof(struct Chip8Shm), PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        if (create) {
+            shm_unlink(handle->name);
+        }
+        return CHIP8_ERROR_MEMORY;
+    }
+
+    handle->shm = address;
+    handle->owner = create;
+    return CHIP8_OK;
+}
+
+/*
+ * Creates a new segment for a running emulator, chip8 is left zeroed. A
+ * name that is already taken gives CHIP8_ERROR_EXISTS.
+ */
+int chip8_shm_create(struct Chip8SharedMemory *handle, const char *name) {
+    int error = shm_map(handle, name, true);
+    if (error != CHIP8_OK) {
+        return error;
+    }
+    handle->shm->magic = CHIP8_SHM_MAGIC;
+    handle->shm->version = CHIP8_SHM_VERSION;
+    atomic_store(&handle->shm->sequence, 0);
+    atomic_store(&handle->shm->keys, 0);
+    return CHIP8_OK;
+}
+
+/* Attaches to a segment created by another process */
+int chip8_shm_attach(struct Chip8SharedMemory *handle, const char *name) {
+    int error = shm_map(handle, name, false);
+    if (error != CHIP8_OK) {
+        return error;
+    }
+    if (handle->shm->magic != CHIP8_SHM_MAGIC ||
+        handle->shm->version != CHIP8_SHM_VERSION) {
+        chip8_shm_destroy(handle);
+        return CHIP8_ERROR_FORMAT;
+    }
+    return CHIP8_OK;
+}
+
+/* Unmaps the segment, the creator also removes its name */
+void chip8_shm_destroy(struct Chip8SharedMemory *handle) {
+    if (handle->shm == NULL) {
+        return;
+    }
+    munmap(handle->shm, sizeof(struct Chip8Shm));
+    if (handle->owner) {
+        shm_unlink(handle->name);
+    }
+    handle->shm = NULL;
+}
+
+/* Marks the state as being written and applies newly injected keys */
+void chip8_shm_begin(struct Chip8SharedMemory *handle) {
+    struct Chip8Shm *shm = handle->shm;
+    uint32_t sequence = atomic_load_explicit(&shm->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&shm->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    /* Only edges are applied so the local keyboard keeps working too */
+    uint16_t keys = atomic_load_explicit(&shm->keys, memory_order_relaxed);
+    uint16_t changed = keys ^ handle->keys;
+    for (int key = 0; changed != 0; key++, changed >>= 1) {
+        if (changed & 1) {
+            shm->chip8.keypad[key] = (keys >> key) & 1;
+        }
+    }
+    handle->keys = keys;
+}
+
+/* Publishes the state written since chip8_shm_begin */
+void chip8_shm_end(struct Chip8SharedMemory *handle, bool frame) {
+    struct Chip8Shm *shm = handle->shm;
+    uint32_t sequence = atomic_load_explicit(&shm->sequence, memory_order_relaxed);
+
+    if (frame) {
+        shm->frames++;
+    }
+    atomic_store_explicit(&shm->sequence, sequence + 1, memory_order_release);
+}
+
+/* Takes a consistent snapshot, retrying while the emulator is writing */
+void chip8_shm_read(const struct Chip8SharedMemory *handle,
+                    struct Chip8 *snapshot, uint64_t *frames) {
+    struct Chip8Shm *shm = handle->shm;
+    uint32_t before, after;
+
+    do {
+        before = atomic_load_explicit(&shm->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(snapshot, &shm->chip8, sizeof(*snapshot));
+        if (frames != NULL) {
+            *frames = shm->frames;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&shm->sequence, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+/* Holds or releases a key, picked up at the emulator's next cycle */
+void chip8_shm_press(struct Chip8SharedMemory *handle, uint8_t key,
+                     bool pressed) {
+    uint16_t mask = 1 << (key & 0xF);
+
+    if (pressed) {
+        atomic_fetch_or(&handle->shm->keys, mask);
+    } else {
+        atomic_fetch_and(&handle->shm->keys, (uint16_t) ~mask);
+    }
+}
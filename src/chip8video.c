@@ -0,0 +1,319 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chip8video.h>
+
+/* Largest payload of a single stored (uncompressed) deflate block */
+#define DEFLATE_STORED_MAX 65535
+
+static bool ends_with(const char *string, const char *suffix) {
+    size_t string_length = strlen(string);
+    size_t suffix_length = strlen(suffix);
+    return string_length >= suffix_length &&
+           strcmp(string + string_length - suffix_length, suffix) == 0;
+}
+
+static void put32(uint8_t *buffer, uint32_t value) {
+    buffer[0] = value >> 24;
+    buffer[1] = value >> 16;
+    buffer[2] = value >> 8;
+    buffer[3] = value;
+}
+
+/* Bitwise CRC-32 as used by PNG chunks, no table so nothing to initialize */
+static uint32_t crc32(const uint8_t *data, size_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+static uint32_t adler32(const uint8_t *data, size_t size) {
+    uint32_t a = 1, b = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return b << 16 | a;
+}
+
+/* Appends a chunk of length bytes whose data is already at buffer + 8 */
+static size_t png_chunk(uint8_t *buffer, const char *type, size_t length) {
+    put32(buffer, length);
+    memcpy(buffer + 4, type, 4);
+    put32(buffer + 8 + length, crc32(buffer + 4, length + 4));
+    return length + 12;
+}
+
+/* Worst case size of an encoded frame, stored blocks never shrink */
+static size_t png_max_size(size_t raw_size) {
+    size_t blocks = raw_size / DEFLATE_STORED_MAX + 1;
+    return 8 + 25 + 12 + 2 + blocks * 5 + raw_size + 4 + 12;
+}
+
+/* Wraps the filtered scanlines in video->pixels into a grayscale PNG */
+static void png_encode(struct Chip8Video *video) {
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G',
+                                         '\r', '\n', 0x1A, '\n'};
+    uint8_t *out = video->encoded;
+    size_t size = 0;
+
+    memcpy(out, signature, sizeof(signature));
+    size += sizeof(signature);
+
+    /* IHDR: 8-bit grayscale, no interlacing */
+    uint8_t *ihdr = out + size + 8;
+    put32(ihdr, video->width);
+    put32(ihdr + 4, video->height);
+    ihdr[8] = 8;
+    ihdr[9] = 0;
+    ihdr[10] = 0;
+    ihdr[11] = 0;
+    ihdr[12] = 0;
+    size += png_chunk(out + size, "IHDR", 13);
+
+    /* IDAT: zlib stream made of stored deflate blocks */
+    uint8_t *idat = out + size + 8;
+    size_t length = 0;
+    idat[length++] = 0x78;
+    idat[length++] = 0x01;
+    for (size_t offset = 0; offset < video->pixels_size;) {
+        size_t block = video->pixels_size - offset;
+        if (block > DEFLATE_STORED_MAX) {
+            block = DEFLATE_STORED_MAX;
+        }
+        idat[length++] = (offset + block == video->pixels_size);
+        idat[length++] = block & 0xFF;
+        idat[length++] = block >> 8;
+        idat[length++] = ~block & 0xFF;
+        idat[length++] = (~block >> 8) & 0xFF;
+        memcpy(idat + length, video->pixels + offset, block);
+        length += block;
+        offset += block;
+    }
+    put32(idat + length, adler32(video->pixels, video->pixels_size));
+    length += 4;
+    size += png_chunk(out + size, "IDAT", length);
+
+    size += png_chunk(out + size, "IEND", 0);
+    video->encoded_size = size;
+}
+
+/* Scales the display into video->pixels in the output's pixel layout */
+static void scale_frame(struct Chip8Video *video, const struct Chip8 *chip8) {
+    size_t bpp = video->format == CHIP8_VIDEO_RGB ? 3 : 1;
+    size_t filter = video->format == CHIP8_VIDEO_PNG ? 1 : 0;
+    size_t stride = filter + video->width * bpp;
+    uint8_t *row = video->pixels;
+
+    for (int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        uint8_t *pixel = row;
+        if (filter) {
+            *pixel++ = 0; /* Filter type None */
+        }
+        for (int x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
+            uint8_t value = chip8->display[y * CHIP8_DISPLAY_WIDTH + x] ? 0xFF : 0x00;
+            memset(pixel, value, bpp * video->scale);
+            pixel += bpp * video->scale;
+        }
+        for (int line = 1; line < video->scale; line++) {
+            memcpy(row + line * stride, row, stride);
+        }
+        row += stride * video->scale;
+    }
+}
+
+/* Writes the current frame buffers out, either to the stream or a new PNG */
+static int emit_frame(struct Chip8Video *video) {
+    if (video->format != CHIP8_VIDEO_PNG) {
+        if (video->format == CHIP8_VIDEO_Y4M &&
+            fputs("FRAME\n", video->output) == EOF) {
+            return CHIP8_ERROR_WRITE;
+        }
+        if (fwrite(video->pixels, 1, video->pixels_size, video->output) !=
+            video->pixels_size) {
+            return CHIP8_ERROR_WRITE;
+        }
+        return CHIP8_OK;
+    }
+
+    char filename[4096];
+    int length = snprintf(filename, sizeof(filename),
+                          video->pattern_zero ? "%.*s%0*lu%s" : "%.*s%*lu%s",
+                          video->pattern_prefix, video->pattern,
+                          video->pattern_width, video->frames,
+                          video->pattern_suffix);
+    if (length < 0 || (size_t) length >= sizeof(filename)) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        return CHIP8_ERROR_OPEN;
+    }
+    size_t written = fwrite(video->encoded, 1, video->encoded_size, file);
+    fclose(file);
+    if (written != video->encoded_size) {
+        return CHIP8_ERROR_WRITE;
+    }
+    return CHIP8_OK;
+}
+
+/*
+ * Splits a pattern such as "frame%05lu.png" around its only conversion,
+ * which must be an integer one. The frame number is formatted by
+ * emit_frame() itself, the path is never used as a format string.
+ */
+static int parse_pattern(struct Chip8Video *video, const char *path) {
+    const char *percent = strchr(path, '%');
+    const char *p;
+    int width = 0;
+
+    if (percent == NULL) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    p = percent + 1;
+    video->pattern_zero = *p == '0';
+    while (*p == '0') {
+        p++;
+    }
+    while (*p >= '0' && *p <= '9') {
+        width = width * 10 + (*p++ - '0');
+        if (width > 64) {
+            return CHIP8_ERROR_ARGUMENT;
+        }
+    }
+    for (int i = 0; i < 2 && *p == 'l'; i++) {
+        p++;
+    }
+    if ((*p != 'd' && *p != 'i' && *p != 'u') || strchr(p + 1, '%') != NULL) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+
+    video->pattern = path;
+    video->pattern_prefix = (int) (percent - path);
+    video->pattern_width = width;
+    video->pattern_suffix = p + 1;
+    return CHIP8_OK;
+}
+
+/*
+ * Opens an exporter. "-" or a .y4m path writes a Y4M stream, a .rgb path
+ * writes raw RGB frames and a path containing one integer conversion such
+ * as "frame%05lu.png" writes one PNG per frame. A "y4m:", "rgb:" or "png:"
+ * prefix picks the format regardless, so "rgb:-" streams RGB to stdout.
+ */
+int chip8_video_open(struct Chip8Video *video, const char *path, int scale) {
+    bool explicit = true;
+
+    memset(video, 0, sizeof(*video));
+
+    if (path == NULL || scale < 1 || scale > CHIP8_VIDEO_MAX_SCALE) {
+        return CHIP8_ERROR_ARGUMENT;
+    }
+    video->scale = scale;
+    video->width = CHIP8_DISPLAY_WIDTH * scale;
+    video->height = CHIP8_DISPLAY_HEIGHT * scale;
+
+    if (strncmp(path, "y4m:", 4) == 0) {
+        video->format = CHIP8_VIDEO_Y4M;
+    } else if (strncmp(path, "rgb:", 4) == 0) {
+        video->format = CHIP8_VIDEO_RGB;
+    } else if (strncmp(path, "png:", 4) == 0) {
+        video->format = CHIP8_VIDEO_PNG;
+    } else if (strchr(path, '%') != NULL) {
+        explicit = false;
+        video->format = CHIP8_VIDEO_PNG;
+    } else {
+        explicit = false;
+        video->format =
+                ends_with(path, ".rgb") ? CHIP8_VIDEO_RGB : CHIP8_VIDEO_Y4M;
+    }
+    if (explicit) {
+        path += 4;
+    }
+
+    if (video->format == CHIP8_VIDEO_PNG) {
+        if (parse_pattern(video, path) != CHIP8_OK) {
+            return CHIP8_ERROR_ARGUMENT;
+        }
+        video->pixels_size = (size_t) video->height * (1 + video->width);
+    } else {
+        video->pixels_size = (size_t) video->height * video->width;
+        if (video->format == CHIP8_VIDEO_RGB) {
+            video->pixels_size *= 3;
+        }
+        video->output = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+        if (video->output == NULL) {
+            return CHIP8_ERROR_OPEN;
+        }
+    }
+
+    video->pixels = malloc(video->pixels_size);
+    if (video->format == CHIP8_VIDEO_PNG) {
+        video->encoded = malloc(png_max_size(video->pixels_size));
+    }
+    if (video->pixels == NULL ||
+        (video->format == CHIP8_VIDEO_PNG && video->encoded == NULL)) {
+        chip8_video_close(video);
+        return CHIP8_ERROR_MEMORY;
+    }
+
+    if (video->format == CHIP8_VIDEO_Y4M) {
+        if (fprintf(video->output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 Cmono\n",
+                    video->width, video->height, CHIP8_VIDEO_FPS) < 0) {
+            chip8_video_close(video);
+            return CHIP8_ERROR_WRITE;
+        }
+    }
+    return CHIP8_OK;
+}
+
+/*
+ * Emits the current display as the next frame. A frame identical to the
+ * previous one reuses the already scaled and encoded buffers.
+ */
+int chip8_video_frame(struct Chip8Video *video, const struct Chip8 *chip8) {
+    uint64_t hash = chip8_hash(chip8->display, CHIP8_DISPLAY_SIZE);
+    bool repeat = video->frames > 0 && hash == video->last_hash &&
+                  memcmp(chip8->display, video->last_display, CHIP8_DISPLAY_SIZE) == 0;
+
+    if (repeat) {
+        video->repeats++;
+    } else {
+        video->last_hash = hash;
+        memcpy(video->last_display, chip8->display, CHIP8_DISPLAY_SIZE);
+        scale_frame(video, chip8);
+        if (video->format == CHIP8_VIDEO_PNG) {
+            png_encode(video);
+        }
+    }
+
+    int error = emit_frame(video);
+    if (error != CHIP8_OK) {
+        return error;
+    }
+    video->frames++;
+    return CHIP8_OK;
+}
+
+void chip8_video_close(struct Chip8Video *video) {
+    if (video->output != NULL && video->output != stdout) {
+        fclose(video->output);
+    } else if (video->output == stdout) {
+        fflush(stdout);
+    }
+    free(video->pixels);
+    free(video->encoded);
+    video->output = NULL;
+    video->pixels = NULL;
+    video->encoded = NULL;
+}
@@ -3,11 +3,27 @@
 #include <chip8.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <chip8golden.h>
+#include <chip8latency.h>
+#include <chip8native.h>
+#include <chip8phosphor.h>
+#ifdef FCHIP8_HAVE_SDL2
 #include <chip8sdl.h>
+#endif
+#include <chip8shm.h>
+#include <chip8video.h>
 
 void print_help(char* filename);
 void cmdline_call_disassemble(int argc, char** argv);
 void cmdline_call_run(int argc, char** argv);
+void cmdline_call_export(int argc, char** argv);
+void cmdline_call_compile(int argc, char** argv);
+void cmdline_call_golden(int argc, char** argv);
+void load_rom(struct Chip8 *chip8, const char *filename);
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
@@ -30,6 +46,21 @@ int main(int argc, char *argv[]) {
         cmdline_call_run(argc, argv);
     }
 
+    /* Headless video export */
+    if ((strcmp(argv[1], "-e") == 0) || (strcmp(argv[1], "--export") == 0)) {
+        cmdline_call_export(argc, argv);
+    }
+
+    /* Ahead-of-time compilation */
+    if ((strcmp(argv[1], "-c") == 0) || (strcmp(argv[1], "--compile") == 0)) {
+        cmdline_call_compile(argc, argv);
+    }
+
+    /* Golden-state regression checks */
+    if ((strcmp(argv[1], "-g") == 0) || (strcmp(argv[1], "--golden") == 0)) {
+        cmdline_call_golden(argc, argv);
+    }
+
     return 0;
 }
 
@@ -38,7 +69,26 @@ void print_help(char* filename) {
     printf("Options:\n");
     printf("  -h, --help\t\tPrint this help message\n");
     printf("  -r, --run\t\tRun the rom\n");
+    printf("    --shm [name]\tShare state and keypad in a POSIX\n");
+    printf("\t\t\tshared-memory segment while running\n");
+    printf("    --native [so]\tRun a ROM built with --compile\n");
+    printf("    --phosphor [decay]\tFade pixels out, keeping decay/256 of\n");
+    printf("\t\t\ttheir brightness per frame (default %d)\n",
+           CHIP8_PHOSPHOR_DEFAULT_DECAY);
+    printf("    --palette [bg,fg]\tColors as RRGGBB,RRGGBB for --phosphor\n");
+    printf("    --latency\t\tMeasure input-to-photon latency, shown in\n");
+    printf("\t\t\tthe title and printed on exit\n");
     printf("  -d, --disassemble\tDisassemble the rom\n");
+    printf("  -e, --export\t\tExport frames: [rom] [out] [scale] [frames]\n");
+    printf("\t\t\tout is - or .y4m (Y4M), .rgb (raw RGB) or a\n");
+    printf("\t\t\tpattern like frame%%05lu.png (PNG sequence),\n");
+    printf("\t\t\ty4m:, rgb: or png: force a format, as in rgb:-\n");
+    printf("\t\t\tscale is 1 to %d\n", CHIP8_VIDEO_MAX_SCALE);
+    printf("  -c, --compile\t\tCompile to C: [rom] [out.c], then build with\n");
+    printf("\t\t\tcc -O2 -shared -fPIC -Iinclude out.c -o rom.so\n");
+    printf("  -g, --golden\t\tRecord or check golden state hashes:\n");
+    printf("\t\t\trecord [list] [frames] or verify [list], each\n");
+    printf("\t\t\tlist line is: rom golden [inputs|-] [rom.so]\n");
 }
 
 void cmdline_call_disassemble(int argc, char** argv) {
@@ -49,9 +99,11 @@ void cmdline_call_disassemble(int argc, char** argv) {
         exit(EXIT_FAILURE);
     }
 
+    int error = CHIP8_OK;
+
     /* If no output file, stdout */
     if (argc == 3) {
-        chip8_disassemble(argv[2], stdout);
+        error = chip8_disassemble(argv[2], stdout);
     }
 
     /* If file, output to file */
@@ -61,7 +113,7 @@ void cmdline_call_disassemble(int argc, char** argv) {
             fprintf(stderr, "Error: Could not open file %s\n", argv[3]);
             exit(EXIT_FAILURE);
         }
-        chip8_disassemble(argv[2], file_descriptor);
+        error = chip8_disassemble(argv[2], file_descriptor);
         fclose(file_descriptor);
     }
 
@@ -71,6 +123,34 @@ void cmdline_call_disassemble(int argc, char** argv) {
         print_help(argv[0]);
         exit(EXIT_FAILURE);
     }
+
+    if (error != CHIP8_OK) {
+        fprintf(stderr, "Error: %s: %s\n", argv[2], chip8_strerror(error));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Only running needs a window, every other mode works without SDL2 */
+#ifdef FCHIP8_HAVE_SDL2
+/* Parses one RRGGBB color, stopping at separator */
+static bool parse_color(const char *text, char separator, const char **end,
+                        unsigned long *color) {
+    char *stop;
+    if (!isxdigit((unsigned char) text[0])) {
+        return false;
+    }
+    errno = 0;
+    *color = strtoul(text, &stop, 16);
+    *end = stop;
+    return errno == 0 && *stop == separator && stop - text <= 6;
+}
+
+/* Parses RRGGBB,RRGGBB for --palette */
+static bool parse_palette(const char *text, unsigned long *background,
+                          unsigned long *foreground) {
+    const char *end;
+    return parse_color(text, ',', &end, background) &&
+           parse_color(end + 1, '\0', &end, foreground);
 }
 
 void cmdline_call_run(int argc, char** argv) {
@@ -81,21 +161,300 @@ void cmdline_call_run(int argc, char** argv) {
         exit(EXIT_FAILURE);
     }
 
-    struct Chip8 current_chip8;
+    /* Optional shared memory, compiled ROM and post-processing */
+    const char *shm_name = NULL;
+    const char *native_path = NULL;
+    bool phosphor_enabled = false;
+    bool latency_enabled = false;
+    long decay = CHIP8_PHOSPHOR_DEFAULT_DECAY;
+    unsigned long background = 0x000000, foreground = 0xFFFFFF;
+    bool palette_set = false;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--shm") == 0 && i + 1 < argc) {
+            shm_name = argv[++i];
+        } else if (strcmp(argv[i], "--native") == 0 && i + 1 < argc) {
+            native_path = argv[++i];
+        } else if (strcmp(argv[i], "--phosphor") == 0) {
+            phosphor_enabled = true;
+            /* The decay is optional */
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                char *end;
+                errno = 0;
+                decay = strtol(argv[++i], &end, 0);
+                if (end == argv[i] || *end != '\0' || errno != 0) {
+                    fprintf(stderr, "Error: Invalid decay %s\n", argv[i]);
+                    exit(EXIT_FAILURE);
+                }
+            }
+        } else if (strcmp(argv[i], "--palette") == 0) {
+            if (i + 1 >= argc ||
+                !parse_palette(argv[i + 1], &background, &foreground)) {
+                fprintf(stderr, "Error: Invalid palette %s, expected "
+                                "RRGGBB,RRGGBB\n",
+                        i + 1 < argc ? argv[i + 1] : "(none)");
+                exit(EXIT_FAILURE);
+            }
+            palette_set = true;
+            i++;
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            latency_enabled = true;
+        } else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            print_help(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (decay < 0 || decay > 255) {
+        fprintf(stderr, "Error: Decay must be between 0 and 255\n");
+        exit(EXIT_FAILURE);
+    }
+    if (palette_set && !phosphor_enabled) {
+        fprintf(stderr, "Error: --palette only applies with --phosphor\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct Chip8 local_chip8;
+    struct Chip8 *current_chip8 = &local_chip8;
+    struct Chip8SharedMemory shared_memory = {0};
     struct SDLChip8 current_sdl_chip8;
-    chip8_init(&current_chip8);
-    chip8_load(&current_chip8, argv[2]);
+    static struct Chip8Native native;
+    static struct Chip8Phosphor phosphor;
+    static struct Chip8Latency latency;
+
+    /* With --shm the emulator runs directly inside the segment */
+    if (shm_name != NULL) {
+        int error = chip8_shm_create(&shared_memory, shm_name);
+        if (error != CHIP8_OK) {
+            fprintf(stderr, "Error: Shared memory %s: %s\n", shm_name,
+                    chip8_strerror(error));
+            if (error == CHIP8_ERROR_EXISTS) {
+                fprintf(stderr, "Another emulator is using it, or one "
+                                "crashed and left it behind (on Linux,\n"
+                                "remove /dev/shm/%s)\n",
+                        shm_name[0] == '/' ? shm_name + 1 : shm_name);
+            }
+            exit(EXIT_FAILURE);
+        }
+        current_chip8 = &shared_memory.shm->chip8;
+    }
+
+    chip8_init(current_chip8);
+    load_rom(current_chip8, argv[2]);
+    /* Interactive sessions get fresh randomness, export and search do not */
+    chip8_seed(current_chip8, (uint32_t) time(NULL));
+
+    /* Compiled blocks span several cycles, so run a frame at a time */
+    unsigned batch = 1;
+    if (native_path != NULL) {
+        int error = chip8_native_open(&native, native_path);
+        if (error != CHIP8_OK) {
+            fprintf(stderr, "Error: %s: %s\n", native_path,
+                    chip8_strerror(error));
+            exit(EXIT_FAILURE);
+        }
+        batch = CHIP8_VIDEO_CYCLES_PER_FRAME > CHIP8_NATIVE_MAX_BLOCK
+                        ? CHIP8_VIDEO_CYCLES_PER_FRAME
+                        : CHIP8_NATIVE_MAX_BLOCK;
+    }
 
     sdl_chip8_init(&current_sdl_chip8, 10);
 
+    if (phosphor_enabled) {
+        chip8_phosphor_init(&phosphor, decay, background, foreground);
+        current_sdl_chip8.phosphor = &phosphor;
+    }
+
+    /* The core always records key reads, measure from a clean slate */
+    Uint32 last_title = SDL_GetTicks();
+    if (latency_enabled) {
+        chip8_latency_init(&latency);
+        current_sdl_chip8.latency = &latency;
+        current_chip8->keys_observed = 0;
+    }
+
     bool quit = false;
     while (!quit) {
-        quit = sdl_chip8_events(&current_sdl_chip8, &current_chip8);
-        chip8_cycle(&current_chip8);
-        chip8_draw(&current_chip8, current_sdl_chip8.renderer,
-                   current_sdl_chip8.texture, current_sdl_chip8.window_scale);
-        SDL_Delay(1);
+        if (shared_memory.shm != NULL) {
+            chip8_shm_begin(&shared_memory);
+        }
+        quit = sdl_chip8_events(&current_sdl_chip8, current_chip8);
+        bool sound = current_chip8->regs.ST > 0;
+        if (native.module != NULL) {
+            chip8_native_run(&native, current_chip8, batch);
+        } else {
+            chip8_cycle(current_chip8);
+        }
+        if (latency_enabled) {
+            chip8_latency_observe(&latency, current_chip8, batch,
+                                  sdl_chip8_microseconds());
+        }
+        /* Drawing clears draw_flag, so it stays inside the seqlock */
+        bool presented = sdl_chip8_draw(&current_sdl_chip8, current_chip8);
+        if (shared_memory.shm != NULL) {
+            chip8_shm_end(&shared_memory, presented);
+        }
+        /* I think SDL has sound maybe ill learn */
+        if (sound && current_chip8->regs.ST == 0) {
+            printf("^_^ :3\n");
+        }
+        if (latency_enabled && SDL_GetTicks() - last_title >= 1000) {
+            char title[128];
+            chip8_latency_summary(&latency, title, sizeof(title));
+            SDL_SetWindowTitle(current_sdl_chip8.window, title);
+            last_title = SDL_GetTicks();
+        }
+        SDL_Delay(batch);
     }
 
+    if (latency_enabled) {
+        chip8_latency_print(&latency, stderr);
+    }
     sdl_chip8_destroy(&current_sdl_chip8);
+    chip8_shm_destroy(&shared_memory);
+    chip8_native_close(&native);
+}
+#else
+void cmdline_call_run(int argc, char** argv) {
+    (void) argc;
+    fprintf(stderr, "Error: %s was built without SDL2, it cannot run roms\n",
+            argv[0]);
+    exit(EXIT_FAILURE);
+}
+#endif
+
+/* Parses a whole decimal or 0x number in [min, max] or exits */
+static long parse_number(const char *text, const char *name, long min,
+                         long max) {
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 0);
+    if (end == text || *end != '\0' || errno != 0) {
+        fprintf(stderr, "Error: Invalid %s %s\n", name, text);
+        exit(EXIT_FAILURE);
+    }
+    if (value < min) {
+        fprintf(stderr, "Error: The %s must be at least %ld\n", name, min);
+        exit(EXIT_FAILURE);
+    }
+    if (value > max) {
+        fprintf(stderr, "Error: The %s must be at most %ld\n", name, max);
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+void cmdline_call_export(int argc, char** argv) {
+    if (argc < 4 || argc > 6) {
+        fprintf(stderr, "Error: Expected a rom and an output\n");
+        print_help(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    int scale = 1;
+    long frames = 60 * CHIP8_VIDEO_FPS;
+    if (argc > 4) {
+        scale = parse_number(argv[4], "scale", 1, CHIP8_VIDEO_MAX_SCALE);
+    }
+    if (argc > 5) {
+        frames = parse_number(argv[5], "frames", 1, LONG_MAX);
+    }
+
+    struct Chip8 current_chip8;
+    struct Chip8Video video;
+    chip8_init(&current_chip8);
+    load_rom(&current_chip8, argv[2]);
+
+    int error = chip8_video_open(&video, argv[3], scale);
+    if (error != CHIP8_OK) {
+        fprintf(stderr, "Error: %s: %s\n", argv[3], chip8_strerror(error));
+        exit(EXIT_FAILURE);
+    }
+
+    for (long frame = 0; frame < frames; frame++) {
+        chip8_run(&current_chip8, CHIP8_VIDEO_CYCLES_PER_FRAME);
+        error = chip8_video_frame(&video, &current_chip8);
+        if (error != CHIP8_OK) {
+            fprintf(stderr, "Error: Frame %ld: %s\n", frame,
+                    chip8_strerror(error));
+            chip8_video_close(&video);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fprintf(stderr, "Exported %lu frames, %lu repeated\n", video.frames,
+            video.repeats);
+    chip8_video_close(&video);
+}
+
+/* Loads a ROM or exits, status goes to stderr to keep stdout for exports */
+void load_rom(struct Chip8 *chip8, const char *filename) {
+    int error = chip8_load(chip8, filename);
+    if (error != CHIP8_OK) {
+        fprintf(stderr, "Error: %s: %s\n", filename, chip8_strerror(error));
+        exit(EXIT_FAILURE);
+    }
+    fprintf(stderr, "Loaded %s into memory\n", filename);
+}
+
+void cmdline_call_compile(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Error: Expected a rom and an output\n");
+        print_help(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* One spare byte to notice ROMs that are too large */
+    uint8_t rom[CHIP8_ROM_MAX_SIZE + 1];
+    FILE *file_descriptor = fopen(argv[2], "rb");
+    if (file_descriptor == NULL) {
+        fprintf(stderr, "Error: Could not open file %s\n", argv[2]);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = fread(rom, 1, sizeof(rom), file_descriptor);
+    fclose(file_descriptor);
+
+    FILE *output = fopen(argv[3], "w");
+    if (output == NULL) {
+        fprintf(stderr, "Error: Could not open file %s\n", argv[3]);
+        exit(EXIT_FAILURE);
+    }
+    int error = chip8_compile(rom, size, output);
+    fclose(output);
+
+    if (error != CHIP8_OK) {
+        fprintf(stderr, "Error: %s: %s\n", argv[2], chip8_strerror(error));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void cmdline_call_golden(int argc, char** argv) {
+    if (argc < 4 || argc > 5 ||
+        (strcmp(argv[2], "record") != 0 && strcmp(argv[2], "verify") != 0)) {
+        fprintf(stderr, "Error: Expected record or verify and a list\n");
+        print_help(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    bool record = strcmp(argv[2], "record") == 0;
+    long frames = argc > 4 ? parse_number(argv[4], "frames", 1, LONG_MAX)
+                           : 60 * CHIP8_VIDEO_FPS;
+
+    unsigned long failures = 0;
+    clock_t start = clock();
+    int error = chip8_golden_list(argv[3], record, frames,
+                                  CHIP8_VIDEO_CYCLES_PER_FRAME, stdout,
+                                  &failures);
+    if (error != CHIP8_OK) {
+        fprintf(stderr, "Error: %s: %s\n", argv[3], chip8_strerror(error));
+        exit(EXIT_FAILURE);
+    }
+
+    if (!record) {
+        double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+        printf("Checked in %.2f s, %lu failed\n", seconds, failures);
+    }
+    if (failures > 0) {
+        exit(EXIT_FAILURE);
+    }
 }
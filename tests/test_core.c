@@ -0,0 +1,81 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chip8.h>
+
+/*
+ * Interpreter checks with results known independently of the core: the
+ * exact pixels a DRW lights, including sprites wrapping past each edge.
+ */
+
+static int failures;
+
+/* Every pixel must be lit exactly when listed */
+static void expect_pixels(const char *name, const struct Chip8 *chip8,
+                          const int (*lit)[2], size_t count) {
+    uint8_t expected[CHIP8_DISPLAY_SIZE] = {0};
+
+    for (size_t i = 0; i < count; i++) {
+        expected[lit[i][1] * CHIP8_DISPLAY_WIDTH + lit[i][0]] = 1;
+    }
+    for (int i = 0; i < CHIP8_DISPLAY_SIZE; i++) {
+        if (chip8->display[i] != expected[i]) {
+            printf("%s: pixel (%d, %d) is %u, expected %u\n", name,
+                   i % CHIP8_DISPLAY_WIDTH, i / CHIP8_DISPLAY_WIDTH,
+                   chip8->display[i], expected[i]);
+            failures++;
+            return;
+        }
+    }
+    printf("%s: ok\n", name);
+}
+
+static void expect_value(const char *name, unsigned actual,
+                         unsigned expected) {
+    if (actual != expected) {
+        printf("%s: 0x%X, expected 0x%X\n", name, actual, expected);
+        failures++;
+    }
+}
+
+int main(void) {
+    struct Chip8 chip8;
+
+    /* Top row of the font "0" (0xF0) at (0, 1) */
+    static const int row[][2] = {{0, 1}, {1, 1}, {2, 1}, {3, 1}};
+    chip8_init(&chip8);
+    chip8.regs.V[0] = 0;
+    chip8.regs.V[1] = 1;
+    chip8.regs.I = 0;
+    chip8_execute(&chip8, 0xD011);
+    expect_pixels("draw", &chip8, row, 4);
+    expect_value("draw VF", chip8.regs.V[0xF], 0);
+    expect_value("draw flag", chip8.draw_flag, 1);
+
+    /* Drawing it again erases it and reports the collision */
+    chip8_execute(&chip8, 0xD011);
+    expect_pixels("erase", &chip8, row, 0);
+    expect_value("erase VF", chip8.regs.V[0xF], 1);
+
+    /* Rows 0xF0 and 0x90 from (62, 31) wrap right and down */
+    static const int wrapped[][2] = {{62, 31}, {63, 31}, {0, 31}, {1, 31},
+                                     {62, 0},  {1, 0}};
+    chip8_init(&chip8);
+    chip8.regs.V[0] = 62;
+    chip8.regs.V[1] = 31;
+    chip8.regs.I = 0;
+    chip8_execute(&chip8, 0xD012);
+    expect_pixels("wrap", &chip8, wrapped, 6);
+
+    /* Coordinates past the screen wrap before drawing */
+    static const int offscreen[][2] = {{4, 2}, {5, 2}, {6, 2}, {7, 2}};
+    chip8_init(&chip8);
+    chip8.regs.V[0] = CHIP8_DISPLAY_WIDTH + 4;
+    chip8.regs.V[1] = CHIP8_DISPLAY_HEIGHT * 3 + 2;
+    chip8.regs.I = 0;
+    chip8_execute(&chip8, 0xD011);
+    expect_pixels("offscreen", &chip8, offscreen, 4);
+
+    return failures > 0;
+}
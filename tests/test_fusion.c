@@ -0,0 +1,151 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chip8.h>
+
+/*
+ * Fusion equivalence: random programs built mostly from the fused idioms,
+ * including code rewritten by Fx33 or Fx55 after it was decoded, must end
+ * in exactly the same state whether run by chip8_cycle(), chip8_step() or
+ * chip8_run().
+ */
+
+#define PROGRAMS 20000
+#define PROGRAM_LENGTH 60
+
+static uint32_t random_state = 1;
+
+static uint32_t next(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static bool same_state(const struct Chip8 *a, const struct Chip8 *b) {
+    return memcmp(&a->regs.V, &b->regs.V, sizeof(a->regs.V)) == 0 &&
+           a->regs.I == b->regs.I && a->regs.PC == b->regs.PC &&
+           a->regs.SP == b->regs.SP && a->regs.DT == b->regs.DT &&
+           a->regs.ST == b->regs.ST && a->rng == b->rng &&
+           memcmp(a->memory, b->memory, sizeof(a->memory)) == 0 &&
+           memcmp(a->display, b->display, sizeof(a->display)) == 0 &&
+           memcmp(a->stack, b->stack, sizeof(a->stack)) == 0;
+}
+
+/* Returns the number of instructions written */
+static int generate(uint16_t *program) {
+    int n = 0;
+
+    while (n < PROGRAM_LENGTH - 4) {
+        uint16_t x = (next() % 14) << 8;
+        uint16_t address = CHIP8_START_ADDRESS + 2 * n;
+
+        switch (next() % 9) {
+            case 0: /* Sprite draw */
+                program[n++] = 0xA000 | next() % 0x50;
+                program[n++] = 0xDEE0 | next() % 6;
+                break;
+            case 1: /* Register load, runs of them form a chain */
+                program[n++] = 0x6000 | x | (next() & 0xFF);
+                break;
+            case 2: /* Delay loop */
+                program[n++] = 0xF015 | x;
+                program[n++] = 0xF007 | x;
+                program[n++] = 0x3000 | x | (next() % 3 == 0 ? 0 : next() % 4);
+                program[n++] = 0x1000 | (address + 2);
+                break;
+            case 3: /* Counted loop */
+                program[n++] = 0x7000 | x | next() % 4;
+                program[n++] = 0x3000 | x | next() % 8;
+                program[n++] = 0x1000 | address;
+                break;
+            case 4: /* Score printing */
+                program[n++] = 0xA300 | next() % 0x10;
+                program[n++] = 0xF033 | x;
+                program[n++] = 0xF065 | (next() % 3) << 8;
+                break;
+            case 5: /* Score printing over its own code */
+                program[n++] = 0xA000 | (address + 4 + (next() % 2) * 2);
+                program[n++] = 0xF033 | x;
+                program[n++] = 0xF065 | (next() % 3) << 8;
+                break;
+            case 6:
+                program[n++] = 0xF018 | x;
+                break;
+            case 7: /* Overwrite code that already ran, then go back to it */
+                if (n > 0) {
+                    uint16_t target = CHIP8_START_ADDRESS + 2 * (next() % n);
+                    program[n++] = 0xA000 | target;
+                    program[n++] = 0xF155;
+                    program[n++] = 0x1000 | target;
+                }
+                break;
+            default:
+                program[n++] = 0x8000 | x | (next() % 14) << 4 | next() % 8;
+                break;
+        }
+    }
+    return n;
+}
+
+int main(void) {
+    static struct Chip8 initial, reference, stepped, run;
+    unsigned long failures = 0, fused = 0;
+
+    for (int test = 0; test < PROGRAMS; test++) {
+        uint8_t rom[2 * PROGRAM_LENGTH];
+        uint16_t program[PROGRAM_LENGTH];
+        int length = generate(program);
+        uint16_t end = CHIP8_START_ADDRESS + 2 * length;
+
+        for (int i = 0; i < length; i++) {
+            rom[2 * i] = program[i] >> 8;
+            rom[2 * i + 1] = program[i] & 0xFF;
+        }
+        chip8_init(&initial);
+        chip8_load_memory(&initial, rom, 2 * length);
+        for (int i = 0; i < CHIP8_REGISTER_COUNT; i++) {
+            initial.regs.V[i] = next() & 7;
+        }
+        initial.regs.V[14] = next() % 20;
+        initial.regs.DT = next() % 40;
+
+        /* Stop before running off the end of the program */
+        unsigned long cycles = 0, budget = 1 + next() % 400;
+        chip8_fork(&initial, &reference);
+        while (cycles < budget && reference.regs.PC < end) {
+            chip8_cycle(&reference);
+            cycles++;
+        }
+
+        chip8_fork(&initial, &stepped);
+        for (unsigned long left = cycles; left > 0;) {
+            unsigned retired = chip8_step(&stepped, left);
+            fused += retired > 1;
+            left -= retired;
+        }
+
+        /* Uneven slices so idioms get cut at budget boundaries */
+        chip8_fork(&initial, &run);
+        for (unsigned long left = cycles; left > 0;) {
+            unsigned long slice = 1 + next() % 7;
+            slice = slice < left ? slice : left;
+            chip8_run(&run, slice);
+            left -= slice;
+        }
+
+        if (!same_state(&reference, &stepped) || !same_state(&reference, &run)) {
+            if (failures++ < 5) {
+                fprintf(stderr, "Program %d differs after %lu cycles\n", test,
+                        cycles);
+            }
+        }
+    }
+
+    printf("%d programs, %lu fused steps, %lu failed\n", PROGRAMS, fused,
+           failures);
+    return failures == 0 && fused > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
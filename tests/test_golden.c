@@ -0,0 +1,127 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chip8.h>
+#include <chip8golden.h>
+
+/*
+ * Golden corpus: every ROM in the list must match its golden file under
+ * each engine chip8_golden_list() checks, and an engine with a planted
+ * bug must be caught on the very instruction it gets wrong. Run from the
+ * directory the list's paths are relative to.
+ *
+ * The golden files only prove the engines agree with the reference, so
+ * sprite.ch8, whose screen is known by hand, is checked pixel by pixel.
+ */
+
+#define SPRITE_ROM "sprite.ch8"
+
+/* The font "0" at (5, 3) and the sprite 0xFF 0x81 at (40, 3) */
+static const char *const sprite_screen[] = {
+        "     ####                               ########",
+        "     #  #                               #      #",
+        "     #  #",
+        "     #  #",
+        "     ####"};
+
+/* chip8_cycle(), except ADD Vx, byte adds one too many */
+static void broken_run(struct Chip8 *chip8, unsigned long cycles,
+                       void *user_data) {
+    (void) user_data;
+    while (cycles-- > 0) {
+        uint16_t pc = chip8->regs.PC & (CHIP8_MEMORY_SIZE - 2);
+        uint8_t high = chip8->memory[pc];
+
+        chip8_cycle(chip8);
+        if ((high & 0xF0) == 0x70) {
+            chip8->regs.V[high & 0x0F]++;
+        }
+    }
+}
+
+static const struct Chip8GoldenEngine broken = {
+        "broken", broken_run, NULL, NULL};
+
+/* The planted bug must be found, and pinned on an ADD Vx, byte */
+static bool check_broken(const char *rom, const char *golden_path) {
+    struct Chip8Golden golden;
+    struct Chip8 initial;
+    struct Chip8GoldenResult result;
+    bool caught;
+
+    chip8_golden_init(&golden, 0);
+    chip8_init(&initial);
+    if (chip8_load(&initial, rom) != CHIP8_OK ||
+        chip8_golden_load(&golden, golden_path) != CHIP8_OK ||
+        chip8_golden_verify(&golden, &initial, &broken, &result) != CHIP8_OK) {
+        printf("%s: broken: could not verify\n", rom);
+        chip8_golden_free(&golden);
+        return false;
+    }
+    chip8_golden_free(&golden);
+
+    caught = result.diverged && !result.reference_agrees &&
+             (result.opcode & 0xF000) == 0x7000;
+    if (!caught) {
+        printf("%s: broken: not located\n", rom);
+        return false;
+    }
+    printf("%s: broken: caught at 0x%03X after %lu cycles\n", rom,
+           result.address, result.cycle);
+    return true;
+}
+
+static bool check_sprite(const struct Chip8GoldenEngine *engine) {
+    struct Chip8 chip8;
+    int top = 3;
+
+    chip8_init(&chip8);
+    if (chip8_load(&chip8, SPRITE_ROM) != CHIP8_OK) {
+        printf("%s: %s: could not load\n", SPRITE_ROM, engine->name);
+        return false;
+    }
+    engine->run(&chip8, 1000, engine->user_data);
+
+    for (int y = 0; y < CHIP8_DISPLAY_HEIGHT; y++) {
+        const char *row = "";
+        if (y >= top && y - top < (int) (sizeof(sprite_screen) /
+                                         sizeof(sprite_screen[0]))) {
+            row = sprite_screen[y - top];
+        }
+        for (int x = 0; x < CHIP8_DISPLAY_WIDTH; x++) {
+            bool lit = x < (int) strlen(row) && row[x] == '#';
+            if (chip8.display[y * CHIP8_DISPLAY_WIDTH + x] != lit) {
+                printf("%s: %s: pixel (%d, %d) should be %s\n", SPRITE_ROM,
+                       engine->name, x, y, lit ? "lit" : "dark");
+                return false;
+            }
+        }
+    }
+    printf("%s: %s: screen ok\n", SPRITE_ROM, engine->name);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    unsigned long failures = 0;
+    int error;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s list\n", argv[0]);
+        return 1;
+    }
+    error = chip8_golden_list(argv[1], false, 0, 0, stdout, &failures);
+    if (error != CHIP8_OK) {
+        fprintf(stderr, "Error: %s: %s\n", argv[1], chip8_strerror(error));
+        return 1;
+    }
+
+    failures += !check_broken("counter.ch8", "counter.gold");
+    failures += !check_broken("selfmod.ch8", "selfmod.gold");
+    failures += !check_sprite(&chip8_golden_reference);
+    failures += !check_sprite(&chip8_golden_fused);
+
+    printf("%lu failed\n", failures);
+    return failures > 0;
+}
@@ -0,0 +1,111 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chip8.h>
+#include <chip8search.h>
+
+/*
+ * Beam search on a ROM whose best input is known: holding key 3 adds 2 to
+ * V0 every loop, key 5 adds 1 and any other key nothing, and the score is
+ * V0. Every key but 3 and 5 leads to the same state, so deduplication
+ * has work to do. Inline and threaded searches must agree exactly.
+ */
+
+#define DEPTH 6
+#define CYCLES_PER_STEP 10
+
+static const uint8_t rom[] = {
+        0x61, 0x03, /* 200: LD V1, 3 */
+        0x62, 0x05, /* 202: LD V2, 5 */
+        0xE1, 0x9E, /* 204: SKP V1 */
+        0x12, 0x0A, /* 206: JP 20A */
+        0x70, 0x02, /* 208: ADD V0, 2 */
+        0xE2, 0x9E, /* 20A: SKP V2 */
+        0x12, 0x10, /* 20C: JP 210 */
+        0x70, 0x01, /* 20E: ADD V0, 1 */
+        0x12, 0x04, /* 210: JP 204 */
+};
+
+static long score_v0(const struct Chip8 *chip8, void *user_data) {
+    (void) user_data;
+    return chip8->regs.V[0];
+}
+
+struct Result {
+    uint8_t inputs[DEPTH];
+    int length;
+    long score;
+    long duplicates;
+};
+
+static bool search(const struct Chip8 *root, int threads,
+                   struct Result *result) {
+    struct Chip8SearchOptions options = {
+            .beam_width = 4,
+            .depth = DEPTH,
+            .cycles_per_step = CYCLES_PER_STEP,
+            .threads = threads,
+            .score = score_v0,
+            .duplicates = &result->duplicates};
+
+    memset(result, 0, sizeof(*result));
+    return chip8_search(root, &options, result->inputs, &result->length,
+                        &result->score) == CHIP8_OK;
+}
+
+int main(void) {
+    struct Chip8 root, replay;
+    struct Result inline_result, threaded_result;
+    int failures = 0;
+
+    chip8_init(&root);
+    chip8_load_memory(&root, rom, sizeof(rom));
+
+    /* The score holding key 3 all along, the best there is */
+    chip8_fork(&root, &replay);
+    replay.keypad[3] = 1;
+    chip8_run(&replay, DEPTH * CYCLES_PER_STEP);
+
+    if (!search(&root, 0, &inline_result) ||
+        !search(&root, 4, &threaded_result)) {
+        printf("search failed\n");
+        return 1;
+    }
+
+    if (inline_result.length != DEPTH ||
+        inline_result.score != replay.regs.V[0]) {
+        printf("inline: length %d score %ld, expected %d and %d\n",
+               inline_result.length, inline_result.score, DEPTH,
+               replay.regs.V[0]);
+        failures++;
+    }
+    for (int i = 0; i < inline_result.length; i++) {
+        if (inline_result.inputs[i] != 3) {
+            printf("inline: input %d is %u, expected 3\n", i,
+                   inline_result.inputs[i]);
+            failures++;
+        }
+    }
+    if (inline_result.duplicates == 0) {
+        printf("inline: no duplicates dropped\n");
+        failures++;
+    }
+
+    if (memcmp(inline_result.inputs, threaded_result.inputs,
+               sizeof(inline_result.inputs)) != 0 ||
+        inline_result.length != threaded_result.length ||
+        inline_result.score != threaded_result.score ||
+        inline_result.duplicates != threaded_result.duplicates) {
+        printf("threaded: differs from inline (score %ld/%ld, "
+               "duplicates %ld/%ld)\n",
+               inline_result.score, threaded_result.score,
+               inline_result.duplicates, threaded_result.duplicates);
+        failures++;
+    }
+
+    printf("score %ld, %ld duplicates dropped: %s\n", inline_result.score,
+           inline_result.duplicates, failures == 0 ? "ok" : "failed");
+    return failures > 0;
+}
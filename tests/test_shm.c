@@ -0,0 +1,123 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chip8.h>
+#include <chip8shm.h>
+
+/*
+ * Shared memory in one process: create, attach, key injection and frame
+ * counting, then a writer thread racing chip8_shm_read(), which must never
+ * return a state the writer was halfway through.
+ */
+
+#define WRITES 20000
+
+static int failures;
+
+static void expect(const char *name, bool condition) {
+    if (!condition) {
+        printf("%s: failed\n", name);
+        failures++;
+    }
+}
+
+/* Every write fills memory with one value and puts the same one in I */
+static void *writer(void *argument) {
+    struct Chip8SharedMemory *handle = argument;
+
+    for (int i = 1; i <= WRITES; i++) {
+        chip8_shm_begin(handle);
+        memset(handle->shm->chip8.memory, i & 0xFF, CHIP8_MEMORY_SIZE / 2);
+        /* Let the reader in halfway, even on a single core */
+        if (i % 64 == 0) {
+            sched_yield();
+        }
+        memset(handle->shm->chip8.memory + CHIP8_MEMORY_SIZE / 2, i & 0xFF,
+               CHIP8_MEMORY_SIZE / 2);
+        handle->shm->chip8.regs.I = i & 0xFF;
+        chip8_shm_end(handle, true);
+    }
+    return NULL;
+}
+
+int main(void) {
+    struct Chip8SharedMemory emulator, external, again;
+    static struct Chip8 snapshot;
+    uint64_t frames = 0;
+    char name[64];
+    int error;
+
+    snprintf(name, sizeof(name), "/fchip8-test-%ld", (long) getpid());
+
+    error = chip8_shm_create(&emulator, name);
+    if (error != CHIP8_OK) {
+        printf("create: %s\n", chip8_strerror(error));
+        return 1;
+    }
+    expect("create taken name",
+           chip8_shm_create(&again, name) == CHIP8_ERROR_EXISTS);
+    expect("attach", chip8_shm_attach(&external, name) == CHIP8_OK);
+
+    /* A published change and a presented frame */
+    chip8_init(&emulator.shm->chip8);
+    chip8_shm_begin(&emulator);
+    emulator.shm->chip8.regs.V[3] = 0x42;
+    chip8_shm_end(&emulator, true);
+    chip8_shm_read(&external, &snapshot, &frames);
+    expect("read", snapshot.regs.V[3] == 0x42 && frames == 1);
+
+    /* Keys land at the next begin, and only on edges */
+    chip8_shm_press(&external, 5, true);
+    chip8_shm_begin(&emulator);
+    expect("press", emulator.shm->chip8.keypad[5] == 1);
+    emulator.shm->chip8.keypad[5] = 0; /* The local keyboard let go */
+    chip8_shm_end(&emulator, false);
+    chip8_shm_begin(&emulator);
+    expect("held", emulator.shm->chip8.keypad[5] == 0);
+    chip8_shm_end(&emulator, false);
+    chip8_shm_press(&external, 5, false);
+    chip8_shm_begin(&emulator);
+    chip8_shm_end(&emulator, false);
+    chip8_shm_press(&external, 5, true);
+    chip8_shm_begin(&emulator);
+    expect("press again", emulator.shm->chip8.keypad[5] == 1);
+    chip8_shm_end(&emulator, false);
+    chip8_shm_read(&external, &snapshot, &frames);
+    expect("no frame", frames == 1);
+
+    /* Snapshots taken during writes are never torn */
+    pthread_t thread;
+    bool torn = false;
+    chip8_shm_begin(&emulator);
+    memset(emulator.shm->chip8.memory, 0, CHIP8_MEMORY_SIZE);
+    emulator.shm->chip8.regs.I = 0;
+    chip8_shm_end(&emulator, false);
+    pthread_create(&thread, NULL, writer, &emulator);
+    for (uint64_t last = frames; last < 1 + WRITES;) {
+        chip8_shm_read(&external, &snapshot, &last);
+        for (int i = 0; i < CHIP8_MEMORY_SIZE; i++) {
+            torn |= snapshot.memory[i] != snapshot.regs.I;
+        }
+    }
+    pthread_join(thread, NULL);
+    expect("seqlock", !torn);
+
+    /* A wrong version is refused, a removed name cannot be attached */
+    emulator.shm->version = CHIP8_SHM_VERSION + 1;
+    expect("version", chip8_shm_attach(&again, name) == CHIP8_ERROR_FORMAT);
+    emulator.shm->version = CHIP8_SHM_VERSION;
+    chip8_shm_destroy(&external);
+    chip8_shm_destroy(&emulator);
+    expect("removed", chip8_shm_attach(&again, name) == CHIP8_ERROR_OPEN);
+
+    printf("%s\n", failures == 0 ? "ok" : "failed");
+    return failures > 0;
+}